@@ -0,0 +1,138 @@
+#include "allocation_counter.h"
+
+#include <malloc.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+static atomic<size_t> allocation_count = 0;
+static atomic<size_t> allocated_bytes = 0;
+
+// Block sizes come from the allocator rather than from a header, so every form of operator
+// delete below, and free in a runtime such as a sanitizer's, can release a block of any form
+// of operator new
+static void* CountAllocation(void* ptr) noexcept {
+    if (ptr != nullptr) {
+        ++allocation_count;
+        allocated_bytes += malloc_usable_size(ptr);
+    }
+    return ptr;
+}
+
+static void* Allocate(size_t size) noexcept {
+    return CountAllocation(malloc(max<size_t>(size, 1)));
+}
+
+static void* Allocate(size_t size, align_val_t alignment) noexcept {
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, max(static_cast<size_t>(alignment), sizeof(void*)), max<size_t>(size, 1)) != 0) {
+        return nullptr;
+    }
+    return CountAllocation(ptr);
+}
+
+static void Deallocate(void* ptr) noexcept {
+    if (ptr == nullptr) {
+        return;
+    }
+    allocated_bytes -= malloc_usable_size(ptr);
+    free(ptr);
+}
+
+void* operator new(size_t size) {
+    if (void* ptr = Allocate(size)) {
+        return ptr;
+    }
+    throw bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    return Allocate(size);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+    return Allocate(size);
+}
+
+void* operator new(size_t size, align_val_t alignment) {
+    if (void* ptr = Allocate(size, alignment)) {
+        return ptr;
+    }
+    throw bad_alloc();
+}
+
+void* operator new[](size_t size, align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+    return Allocate(size, alignment);
+}
+
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+    return Allocate(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept {
+    Deallocate(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    Deallocate(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    Deallocate(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    Deallocate(ptr);
+}
+
+void operator delete(void* ptr, const nothrow_t&) noexcept {
+    Deallocate(ptr);
+}
+
+void operator delete[](void* ptr, const nothrow_t&) noexcept {
+    Deallocate(ptr);
+}
+
+void operator delete(void* ptr, align_val_t) noexcept {
+    Deallocate(ptr);
+}
+
+void operator delete[](void* ptr, align_val_t) noexcept {
+    Deallocate(ptr);
+}
+
+void operator delete(void* ptr, size_t, align_val_t) noexcept {
+    Deallocate(ptr);
+}
+
+void operator delete[](void* ptr, size_t, align_val_t) noexcept {
+    Deallocate(ptr);
+}
+
+void operator delete(void* ptr, align_val_t, const nothrow_t&) noexcept {
+    Deallocate(ptr);
+}
+
+void operator delete[](void* ptr, align_val_t, const nothrow_t&) noexcept {
+    Deallocate(ptr);
+}
+
+size_t GetAllocationCount() {
+    return allocation_count;
+}
+
+size_t GetAllocatedBytes() {
+    return allocated_bytes;
+}
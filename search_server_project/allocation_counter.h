@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+
+// Every form of global operator new and delete is replaced in allocation_counter.cpp,
+// so linking it into a program makes every heap allocation observable.
+size_t GetAllocationCount();
+
+// Bytes currently held by live allocations, as rounded up by malloc
+size_t GetAllocatedBytes();
@@ -0,0 +1,100 @@
+#include "async_request_queue.h"
+
+#include <exception>
+#include <execution>
+#include <utility>
+
+using namespace std;
+
+AsyncRequestQueue::AsyncRequestQueue(const SearchServer& search_server, size_t thread_count, size_t queue_capacity,
+                                     size_t cache_byte_budget)
+    : search_server_(search_server)
+    , requests_(max<size_t>(1, queue_capacity))
+    , cache_(cache_byte_budget) {
+    for (size_t i = 0; i < max<size_t>(1, thread_count); ++i) {
+        workers_.emplace_back(&AsyncRequestQueue::RunWorker, this);
+    }
+}
+
+AsyncRequestQueue::~AsyncRequestQueue() {
+    requests_.Close();
+    for (thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+future<vector<Document>> AsyncRequestQueue::Submit(string raw_query, DocumentStatus status, Clock::time_point deadline) {
+    Request request{move(raw_query), status, deadline, Clock::now(), {}};
+    auto result = request.result.get_future();
+    requests_.Push(move(request));
+    return result;
+}
+
+optional<future<vector<Document>>> AsyncRequestQueue::TrySubmit(string raw_query, DocumentStatus status, Clock::time_point deadline) {
+    Request request{move(raw_query), status, deadline, Clock::now(), {}};
+    auto result = request.result.get_future();
+    if (!requests_.TryPush(move(request))) {
+        ++rejected_count_;
+        return nullopt;
+    }
+    return result;
+}
+
+int AsyncRequestQueue::GetNoResultRequests() const {
+    lock_guard<mutex> guard(mutex_);
+    return empty_results_.GetEmptyCount();
+}
+
+chrono::nanoseconds AsyncRequestQueue::GetLatencyPercentile(double percentile) const {
+    return latencies_.GetPercentile(percentile);
+}
+
+size_t AsyncRequestQueue::GetRejectedCount() const {
+    return rejected_count_;
+}
+
+size_t AsyncRequestQueue::GetExpiredCount() const {
+    return expired_count_;
+}
+
+void AsyncRequestQueue::RunWorker() {
+    while (auto request = requests_.Pop()) {
+        Answer(*request);
+    }
+}
+
+void AsyncRequestQueue::Answer(Request& request) {
+    try {
+        // A request which waited past its deadline is not scored at all
+        if (Clock::now() >= request.deadline) {
+            throw DeadlineExceededError();
+        }
+        auto query = search_server_.CompileQuery(request.raw_query);
+        query.deadline = request.deadline;
+        const string key = MakeQueryKey(query, request.status);
+        optional<vector<Document>> documents;
+        {
+            lock_guard<mutex> guard(mutex_);
+            if (const auto* cached_documents = cache_.Find(key, query.index_generation)) {
+                documents = *cached_documents;
+            }
+        }
+        if (!documents) {
+            documents = search_server_.FindTopDocuments(execution::seq, query, request.status);
+            lock_guard<mutex> guard(mutex_);
+            cache_.Insert(key, query.index_generation, *documents);
+        }
+        {
+            lock_guard<mutex> guard(mutex_);
+            empty_results_.Record(documents->empty());
+        }
+        const Clock::time_point now = Clock::now();
+        latencies_.Record(now - request.submit_time, now);
+        request.result.set_value(move(*documents));
+    } catch (const DeadlineExceededError&) {
+        ++expired_count_;
+        request.result.set_exception(current_exception());
+    } catch (...) {
+        request.result.set_exception(current_exception());
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "bounded_queue.h"
+#include "latency_histogram.h"
+#include "query_cache.h"
+#include "request_queue.h"
+#include "search_server.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Answers find requests on worker threads. Requests wait in a queue of limited capacity: Submit
+// blocks while it is full, TrySubmit turns the request away instead. A request whose deadline
+// passes before it is answered fails with DeadlineExceededError, and scoring stops early.
+// The server must not change while the queue is alive.
+class AsyncRequestQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    AsyncRequestQueue(const SearchServer& search_server, size_t thread_count = std::max(1u, std::thread::hardware_concurrency()),
+                      size_t queue_capacity = 1024, size_t cache_byte_budget = 16 << 20);
+
+    AsyncRequestQueue(const AsyncRequestQueue&) = delete;
+
+    AsyncRequestQueue& operator=(const AsyncRequestQueue&) = delete;
+
+    // Answers the requests already queued, then stops the workers
+    ~AsyncRequestQueue();
+
+    std::future<std::vector<Document>> Submit(std::string raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+                                              Clock::time_point deadline = Clock::time_point::max());
+
+    // Returns nullopt without waiting if the queue is full
+    std::optional<std::future<std::vector<Document>>> TrySubmit(std::string raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+                                                                Clock::time_point deadline = Clock::time_point::max());
+
+    // Among the last 1440 answered requests
+    int GetNoResultRequests() const;
+
+    // Time from submission to answer of requests answered within the last minute
+    std::chrono::nanoseconds GetLatencyPercentile(double percentile) const;
+
+    size_t GetRejectedCount() const;
+
+    size_t GetExpiredCount() const;
+
+private:
+    struct Request {
+        std::string raw_query;
+        DocumentStatus status;
+        Clock::time_point deadline;
+        Clock::time_point submit_time;
+        std::promise<std::vector<Document>> result;
+    };
+
+    const SearchServer& search_server_;
+    BoundedQueue<Request> requests_;
+    // Guards the cache and the empty result window
+    mutable std::mutex mutex_;
+    QueryCache cache_;
+    EmptyResultWindow empty_results_;
+    LatencyHistogram latencies_;
+    std::atomic<size_t> rejected_count_{0};
+    std::atomic<size_t> expired_count_{0};
+    std::vector<std::thread> workers_;
+
+    void RunWorker();
+
+    void Answer(Request& request);
+};
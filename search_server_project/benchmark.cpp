@@ -0,0 +1,757 @@
+#include "search_server.h"
+#include "allocation_counter.h"
+#include "async_request_queue.h"
+#include "concurrent_search_server.h"
+#include "ingest_documents.h"
+#include "instrumentation.h"
+#include "ordinal_set_ops.h"
+#include "process_queries.h"
+#include "random_text.h"
+#include "remove_duplicates.h"
+#include "request_queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <execution>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+using Clock = chrono::steady_clock;
+
+// Each query is matched against this many documents in the MatchDocument benchmarks
+constexpr int MATCHES_PER_QUERY = 10;
+// Rounds of the corpus queries sent through RequestQueue, so all but the first are cache hits
+constexpr int CACHED_QUERY_ROUNDS = 10;
+// Documents a writer thread adds while queries are timed
+constexpr int DOCUMENTS_ADDED_UNDER_READS = 200;
+// Samples of each ordinal set operation per repetition
+constexpr int SET_OPERATIONS_PER_REPETITION = 20;
+
+const string SNAPSHOT_PATH = "search_server_benchmark.snapshot"s;
+
+struct BenchmarkConfig {
+    int document_count = 10'000;
+    int vocabulary_size = 1'000;
+    int max_word_length = 10;
+    int document_word_count = 70;
+    int query_count = 100;
+    int query_word_count = 10;
+    double minus_probability = 0.1;
+    int removal_count = 1'000;
+    int warm_up_count = 1;
+    int repetition_count = 5;
+    unsigned seed = 5489;
+    // Only benchmarks whose names contain it are run
+    string filter;
+    string json_path;
+};
+
+struct Option {
+    string name;
+    string description;
+    function<void(const string&)> parse;
+};
+
+vector<Option> GetOptions(BenchmarkConfig& config) {
+    const auto int_option = [](int& value) {
+        return [&value](const string& text) {
+            value = stoi(text);
+            if (value < 0) {
+                throw invalid_argument("Negative value");
+            }
+        };
+    };
+    return {
+        {"documents", "documents in the corpus", int_option(config.document_count)},
+        {"vocabulary", "distinct words to draw documents and queries from", int_option(config.vocabulary_size)},
+        {"word-length", "maximum word length", int_option(config.max_word_length)},
+        {"document-words", "words per document", int_option(config.document_word_count)},
+        {"queries", "queries per repetition", int_option(config.query_count)},
+        {"query-words", "words per query", int_option(config.query_word_count)},
+        {"minus-probability", "probability of a query word to be a minus word",
+         [&config](const string& text) {
+             config.minus_probability = stod(text);
+         }},
+        {"removals", "documents removed per repetition", int_option(config.removal_count)},
+        {"warm-up", "untimed repetitions before the timed ones", int_option(config.warm_up_count)},
+        {"repetitions", "timed repetitions", int_option(config.repetition_count)},
+        {"seed", "seed of the corpus and queries",
+         [&config](const string& text) {
+             config.seed = stoul(text);
+         }},
+        {"filter", "run only benchmarks whose names contain this",
+         [&config](const string& text) {
+             config.filter = text;
+         }},
+        {"json", "file to write the results to as JSON",
+         [&config](const string& text) {
+             config.json_path = text;
+         }},
+    };
+}
+
+void PrintUsage(const vector<Option>& options) {
+    cerr << "Usage: search_server_benchmark [--option=value]..."s << endl;
+    for (const Option& option : options) {
+        cerr << "  --"s << left << setw(20) << option.name << option.description << endl;
+    }
+}
+
+bool ParseConfig(int argc, char** argv, BenchmarkConfig& config) {
+    const vector<Option> options = GetOptions(config);
+    for (int i = 1; i < argc; ++i) {
+        const string argument = argv[i];
+        if (argument == "--help"s) {
+            PrintUsage(GetOptions(config));
+            return false;
+        }
+        const size_t separator = argument.find('=');
+        const auto option = find_if(options.begin(), options.end(), [&argument, separator](const Option& option) {
+            return argument.compare(0, separator, "--"s + option.name) == 0;
+        });
+        if (argument.compare(0, 2, "--"s) != 0 || separator == string::npos || option == options.end()) {
+            cerr << "Unknown argument "s << argument << endl;
+            PrintUsage(options);
+            return false;
+        }
+        try {
+            option->parse(argument.substr(separator + 1));
+        } catch (const exception&) {
+            cerr << "Invalid value of "s << argument.substr(0, separator) << endl;
+            PrintUsage(options);
+            return false;
+        }
+    }
+    if (config.document_count == 0 || config.vocabulary_size == 0 || config.max_word_length == 0 || config.repetition_count == 0) {
+        cerr << "documents, vocabulary, word-length and repetitions must be positive"s << endl;
+        return false;
+    }
+    return true;
+}
+
+struct BenchmarkResult {
+    string name;
+    // A sample times this many operations, such as documents indexed
+    size_t operations_per_sample = 1;
+    // Sorted
+    vector<chrono::nanoseconds> samples;
+    // Heap allocations made within the samples
+    size_t allocation_count = 0;
+    // Derived from the results of the last repetition, to tell whether versions compute the same
+    size_t checksum = 0;
+};
+
+// Times operations of a repetition; warm-up repetitions record nothing
+class SampleRecorder {
+public:
+    explicit SampleRecorder(BenchmarkResult* result)
+        : result_(result) {
+    }
+
+    template <typename Operation>
+    void Time(Operation operation) {
+        const size_t start_allocation_count = GetAllocationCount();
+        const Clock::time_point start = Clock::now();
+        operation();
+        const Clock::duration duration = Clock::now() - start;
+        if (result_ != nullptr) {
+            result_->samples.push_back(chrono::duration_cast<chrono::nanoseconds>(duration));
+            result_->allocation_count += GetAllocationCount() - start_allocation_count;
+        }
+    }
+
+private:
+    BenchmarkResult* result_;
+};
+
+// Runs repetition(recorder), which returns its checksum, warm_up_count times untimed and then
+// repetition_count times timed
+template <typename Repetition>
+BenchmarkResult RunBenchmark(const BenchmarkConfig& config, string name, size_t operations_per_sample, const Repetition& repetition) {
+    SampleRecorder warm_up_recorder(nullptr);
+    for (int i = 0; i < config.warm_up_count; ++i) {
+        repetition(warm_up_recorder);
+    }
+    BenchmarkResult result{move(name), operations_per_sample, {}, 0, 0};
+    SampleRecorder recorder(&result);
+    for (int i = 0; i < config.repetition_count; ++i) {
+        result.checksum = repetition(recorder);
+    }
+    sort(result.samples.begin(), result.samples.end());
+    return result;
+}
+
+// Nearest-rank percentile of sorted samples
+chrono::nanoseconds GetPercentile(const vector<chrono::nanoseconds>& samples, double fraction) {
+    if (samples.empty()) {
+        return chrono::nanoseconds(0);
+    }
+    const size_t rank = static_cast<size_t>(fraction * samples.size());
+    return samples[min(samples.size() - 1, rank)];
+}
+
+chrono::nanoseconds GetTotal(const vector<chrono::nanoseconds>& samples) {
+    chrono::nanoseconds total(0);
+    for (const chrono::nanoseconds sample : samples) {
+        total += sample;
+    }
+    return total;
+}
+
+double GetOperationsPerSecond(const BenchmarkResult& result) {
+    const double seconds = chrono::duration<double>(GetTotal(result.samples)).count();
+    return seconds > 0 ? result.operations_per_sample * result.samples.size() / seconds : 0;
+}
+
+double GetAllocationsPerOperation(const BenchmarkResult& result) {
+    const size_t operation_count = result.operations_per_sample * result.samples.size();
+    return operation_count > 0 ? static_cast<double>(result.allocation_count) / operation_count : 0;
+}
+
+void PrintResultHeader(ostream& output) {
+    output << left << setw(28) << "benchmark"s << right << setw(9) << "samples"s << setw(12) << "median us"s << setw(12) << "p90 us"s
+           << setw(12) << "p99 us"s << setw(12) << "max us"s << setw(14) << "ops/s"s << setw(12) << "allocs/op"s << endl;
+}
+
+void PrintResult(ostream& output, const BenchmarkResult& result) {
+    const auto microseconds = [](chrono::nanoseconds duration) {
+        return chrono::duration<double, micro>(duration).count();
+    };
+    output << left << setw(28) << result.name << right << setw(9) << result.samples.size() << fixed << setprecision(1) << setw(12)
+           << microseconds(GetPercentile(result.samples, 0.5)) << setw(12) << microseconds(GetPercentile(result.samples, 0.9)) << setw(12)
+           << microseconds(GetPercentile(result.samples, 0.99)) << setw(12) << microseconds(GetPercentile(result.samples, 1)) << setprecision(0)
+           << setw(14) << GetOperationsPerSecond(result) << setprecision(1) << setw(12) << GetAllocationsPerOperation(result) << defaultfloat
+           << setprecision(6) << endl;
+}
+
+void WriteJson(ostream& output, const BenchmarkConfig& config, const vector<BenchmarkResult>& results) {
+    output << "{\"config\":{\"documents\":" << config.document_count << ",\"vocabulary\":" << config.vocabulary_size
+           << ",\"word_length\":" << config.max_word_length << ",\"document_words\":" << config.document_word_count
+           << ",\"queries\":" << config.query_count << ",\"query_words\":" << config.query_word_count
+           << ",\"minus_probability\":" << config.minus_probability << ",\"removals\":" << config.removal_count
+           << ",\"warm_up\":" << config.warm_up_count << ",\"repetitions\":" << config.repetition_count << ",\"seed\":" << config.seed
+           << ",\"hardware_threads\":" << thread::hardware_concurrency() << ",\"instrumentation\":"
+#ifdef SEARCH_SERVER_INSTRUMENTATION
+           << "true"
+#else
+           << "false"
+#endif
+           << "},\"results\":[";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& result = results[i];
+        const auto nanoseconds = [](chrono::nanoseconds duration) {
+            return duration.count();
+        };
+        output << (i > 0 ? "," : "") << "{\"name\":\"" << result.name << "\",\"samples\":" << result.samples.size()
+               << ",\"operations_per_sample\":" << result.operations_per_sample
+               << ",\"min_ns\":" << nanoseconds(GetPercentile(result.samples, 0))
+               << ",\"median_ns\":" << nanoseconds(GetPercentile(result.samples, 0.5))
+               << ",\"p90_ns\":" << nanoseconds(GetPercentile(result.samples, 0.9))
+               << ",\"p99_ns\":" << nanoseconds(GetPercentile(result.samples, 0.99))
+               << ",\"max_ns\":" << nanoseconds(GetPercentile(result.samples, 1))
+               << ",\"mean_ns\":" << (result.samples.empty() ? 0 : nanoseconds(GetTotal(result.samples)) / static_cast<long long>(result.samples.size()))
+               << ",\"operations_per_second\":" << static_cast<long long>(GetOperationsPerSecond(result))
+               << ",\"allocations_per_operation\":" << GetAllocationsPerOperation(result)
+               << ",\"checksum\":" << result.checksum << '}';
+    }
+    output << "]}\n";
+}
+
+struct Corpus {
+    vector<string> dictionary;
+    vector<RawDocument> documents;
+    vector<string> queries;
+};
+
+Corpus GenerateCorpus(const BenchmarkConfig& config) {
+    mt19937 generator(config.seed);
+    Corpus corpus;
+    corpus.dictionary = GenerateDictionary(generator, config.vocabulary_size, config.max_word_length);
+    const vector<string> texts = GenerateQueries(generator, corpus.dictionary, config.document_count, config.document_word_count);
+    for (int id = 0; id < config.document_count; ++id) {
+        // Every tenth document is not ACTUAL, so the status filter has something to drop
+        corpus.documents.push_back({id, texts[id], id % 10 == 0 ? DocumentStatus::IRRELEVANT : DocumentStatus::ACTUAL, {id % 7, 3}});
+    }
+    corpus.queries = GenerateQueries(generator, corpus.dictionary, config.query_count, config.query_word_count, config.minus_probability);
+    return corpus;
+}
+
+SearchServer CreateSearchServer(const Corpus& corpus) {
+    SearchServer search_server(corpus.dictionary[0]);
+    search_server.AddDocuments(corpus.documents);
+    return search_server;
+}
+
+class BenchmarkSuite {
+public:
+    explicit BenchmarkSuite(const BenchmarkConfig& config)
+        : config_(config)
+        , corpus_(GenerateCorpus(config))
+        , search_server_(CreateSearchServer(corpus_)) {
+    }
+
+    vector<BenchmarkResult> Run() {
+        RunIndex("index"s, InvertedIndex::DEFAULT_BUFFER_LIMIT);
+        // The postings stay in one buffer instead of being merged into segments
+        RunIndex("index_one_buffer"s, numeric_limits<size_t>::max());
+        RunAddDocuments("index_batch_seq"s, execution::seq);
+        RunAddDocuments("index_batch_par"s, execution::par);
+        RunIngestDocuments();
+        RunSnapshot();
+        RunFindTopDocuments("find_top_seq"s, execution::seq);
+        RunFindTopDocuments("find_top_par"s, execution::par);
+        RunFindTopDocumentsByStatus();
+        RunFindTopDocumentsCompacted();
+        RunFindTopDocumentsWithCommonWord("find_top_common_pruned"s, RetrievalMode::PRUNED);
+        RunFindTopDocumentsWithCommonWord("find_top_common_exhaustive"s, RetrievalMode::EXHAUSTIVE);
+        RunFindTopDocumentsSharded();
+        RunMatchDocument("match_seq"s, execution::seq);
+        RunMatchDocument("match_par"s, execution::par);
+        RunMatchDocuments("match_batch_seq"s, execution::seq);
+        RunMatchDocuments("match_batch_par"s, execution::par);
+        RunRemoveDocument("remove_seq"s, execution::seq);
+        RunRemoveDocument("remove_par"s, execution::par);
+        RunRemoveDocuments("remove_batch_seq"s, execution::seq);
+        RunRemoveDocuments("remove_batch_par"s, execution::par);
+        RunRemoveDuplicates("remove_duplicates_exact"s, 1.0);
+        RunRemoveDuplicates("remove_duplicates_near"s, 0.8);
+        RunIfSelected("process_queries"s, corpus_.queries.size(), [this](SampleRecorder& recorder) {
+            size_t found_count = 0;
+            recorder.Time([&] {
+                for (const auto& documents : ProcessQueries(search_server_, corpus_.queries)) {
+                    found_count += documents.size();
+                }
+            });
+            return found_count;
+        });
+        RunIfSelected("process_queries_joined"s, corpus_.queries.size(), [this](SampleRecorder& recorder) {
+            size_t found_count = 0;
+            recorder.Time([&] {
+                found_count = ProcessQueriesJoined(search_server_, corpus_.queries).size();
+            });
+            return found_count;
+        });
+        RunRequestQueue();
+        RunAsyncRequestQueue();
+        RunFindTopDocumentsUnderWrites();
+        RunOrdinalSetOps();
+        return move(results_);
+    }
+
+private:
+    const BenchmarkConfig& config_;
+    const Corpus corpus_;
+    const SearchServer search_server_;
+    vector<BenchmarkResult> results_;
+
+    // The j-th document matched against the i-th query
+    int GetMatchedDocumentId(size_t query_index, int j) const {
+        return static_cast<int>((query_index * 7919 + j * 104729) % config_.document_count);
+    }
+
+    // Documents spread over the whole corpus
+    vector<int> GetRemovedDocumentIds() const {
+        const int removal_count = min(config_.removal_count, config_.document_count);
+        vector<int> document_ids;
+        document_ids.reserve(removal_count);
+        for (int i = 0; i < removal_count; ++i) {
+            document_ids.push_back(static_cast<int>(static_cast<long long>(i) * config_.document_count / removal_count));
+        }
+        return document_ids;
+    }
+
+    template <typename Repetition>
+    void RunIfSelected(string name, size_t operations_per_sample, const Repetition& repetition) {
+        if (name.find(config_.filter) == string::npos) {
+            return;
+        }
+        results_.push_back(RunBenchmark(config_, move(name), operations_per_sample, repetition));
+        PrintResult(cout, results_.back());
+    }
+
+    void RunIndex(string name, size_t buffer_limit) {
+        RunIfSelected(move(name), config_.document_count, [this, buffer_limit](SampleRecorder& recorder) {
+            SearchServer search_server(corpus_.dictionary[0]);
+            search_server.SetIndexBufferLimit(buffer_limit);
+            recorder.Time([&] {
+                for (const RawDocument& document : corpus_.documents) {
+                    search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+                }
+            });
+            return static_cast<size_t>(search_server.GetDocumentCount());
+        });
+    }
+
+    template <typename ExecutionPolicy>
+    void RunAddDocuments(string name, ExecutionPolicy policy) {
+        RunIfSelected(move(name), config_.document_count, [this, policy](SampleRecorder& recorder) {
+            SearchServer search_server(corpus_.dictionary[0]);
+            recorder.Time([&] {
+                search_server.AddDocuments(policy, corpus_.documents);
+            });
+            return static_cast<size_t>(search_server.GetDocumentCount());
+        });
+    }
+
+    void RunIngestDocuments() {
+        RunIfSelected("ingest_json_lines"s, config_.document_count, [this](SampleRecorder& recorder) {
+            string json_lines;
+            for (const RawDocument& document : corpus_.documents) {
+                json_lines += "{\"id\": "s + to_string(document.id) + ", \"text\": \""s + document.text + "\", \"status\": \""s
+                              + (document.status == DocumentStatus::ACTUAL ? "ACTUAL"s : "IRRELEVANT"s) + "\", \"ratings\": ["s
+                              + to_string(document.ratings[0]) + ", "s + to_string(document.ratings[1]) + "]}\n"s;
+            }
+            SearchServer search_server(corpus_.dictionary[0]);
+            istringstream input(json_lines);
+            recorder.Time([&] {
+                IngestDocuments(search_server, input);
+            });
+            return static_cast<size_t>(search_server.GetDocumentCount());
+        });
+    }
+
+    void RunSnapshot() {
+        RunIfSelected("save_index"s, 1, [this](SampleRecorder& recorder) {
+            recorder.Time([&] {
+                search_server_.SaveIndex(SNAPSHOT_PATH);
+            });
+            remove(SNAPSHOT_PATH.c_str());
+            return static_cast<size_t>(search_server_.GetDocumentCount());
+        });
+        RunIfSelected("load_index"s, 1, [this](SampleRecorder& recorder) {
+            search_server_.SaveIndex(SNAPSHOT_PATH);
+            optional<SearchServer> search_server;
+            recorder.Time([&] {
+                search_server.emplace(SearchServer::LoadIndex(SNAPSHOT_PATH));
+            });
+            remove(SNAPSHOT_PATH.c_str());
+            return static_cast<size_t>(search_server->GetDocumentCount());
+        });
+    }
+
+    // Times each of the corpus queries; returns the number of documents found
+    template <typename ExecutionPolicy>
+    size_t TimeFindTopDocuments(SampleRecorder& recorder, const SearchServer& search_server, ExecutionPolicy policy,
+                                const vector<string>& queries) const {
+        size_t found_count = 0;
+        for (const string& query : queries) {
+            recorder.Time([&] {
+                found_count += search_server.FindTopDocuments(policy, query).size();
+            });
+        }
+        return found_count;
+    }
+
+    template <typename ExecutionPolicy>
+    void RunFindTopDocuments(string name, ExecutionPolicy policy) {
+        RunIfSelected(move(name), 1, [this, policy](SampleRecorder& recorder) {
+            return TimeFindTopDocuments(recorder, search_server_, policy, corpus_.queries);
+        });
+    }
+
+    // The status overload against a predicate which selects the same documents
+    void RunFindTopDocumentsByStatus() {
+        RunIfSelected("find_top_status"s, 1, [this](SampleRecorder& recorder) {
+            size_t found_count = 0;
+            for (const string& query : corpus_.queries) {
+                recorder.Time([&] {
+                    found_count += search_server_.FindTopDocuments(query, DocumentStatus::ACTUAL).size();
+                });
+            }
+            return found_count;
+        });
+        RunIfSelected("find_top_predicate"s, 1, [this](SampleRecorder& recorder) {
+            size_t found_count = 0;
+            for (const string& query : corpus_.queries) {
+                recorder.Time([&] {
+                    found_count += search_server_.FindTopDocuments(query, [](int document_id, DocumentStatus status, int rating) {
+                        return status == DocumentStatus::ACTUAL;
+                    }).size();
+                });
+            }
+            return found_count;
+        });
+    }
+
+    void RunFindTopDocumentsCompacted() {
+        RunIfSelected("find_top_compacted"s, 1, [this](SampleRecorder& recorder) {
+            SearchServer search_server = search_server_;
+            search_server.CompactIndex();
+            return TimeFindTopDocuments(recorder, search_server, execution::seq, corpus_.queries);
+        });
+    }
+
+    // Nine documents in ten contain a word every query has, which pruning should skip past
+    void RunFindTopDocumentsWithCommonWord(string name, RetrievalMode mode) {
+        RunIfSelected(move(name), 1, [this, mode](SampleRecorder& recorder) {
+            vector<RawDocument> documents = corpus_.documents;
+            for (size_t i = 0; i < documents.size(); ++i) {
+                if (i % 10 != 0) {
+                    documents[i].text += " common"s;
+                }
+            }
+            SearchServer search_server(corpus_.dictionary[0]);
+            search_server.AddDocuments(execution::par, documents);
+            search_server.SetRetrievalMode(mode);
+            vector<string> queries;
+            queries.reserve(corpus_.queries.size());
+            for (const string& query : corpus_.queries) {
+                queries.push_back("common "s + query);
+            }
+            return TimeFindTopDocuments(recorder, search_server, execution::seq, queries);
+        });
+    }
+
+    // Parallel queries over 1, 2, 4... shards up to the hardware threads
+    void RunFindTopDocumentsSharded() {
+        const size_t max_shard_count = max(1u, thread::hardware_concurrency());
+        for (size_t shard_count = 1;; shard_count = min(shard_count * 2, max_shard_count)) {
+            RunIfSelected("find_top_par_shards_"s + to_string(shard_count), 1, [this, shard_count](SampleRecorder& recorder) {
+                SearchServer search_server = search_server_;
+                search_server.SetParallelShardCount(shard_count);
+                return TimeFindTopDocuments(recorder, search_server, execution::par, corpus_.queries);
+            });
+            if (shard_count == max_shard_count) {
+                break;
+            }
+        }
+    }
+
+    template <typename ExecutionPolicy>
+    void RunMatchDocument(string name, ExecutionPolicy policy) {
+        RunIfSelected(move(name), 1, [this, policy](SampleRecorder& recorder) {
+            size_t matched_count = 0;
+            for (size_t i = 0; i < corpus_.queries.size(); ++i) {
+                for (int j = 0; j < MATCHES_PER_QUERY; ++j) {
+                    recorder.Time([&] {
+                        matched_count += get<0>(search_server_.MatchDocument(policy, corpus_.queries[i], GetMatchedDocumentId(i, j))).size();
+                    });
+                }
+            }
+            return matched_count;
+        });
+    }
+
+    template <typename ExecutionPolicy>
+    void RunMatchDocuments(string name, ExecutionPolicy policy) {
+        RunIfSelected(move(name), MATCHES_PER_QUERY, [this, policy](SampleRecorder& recorder) {
+            size_t matched_count = 0;
+            vector<int> document_ids(MATCHES_PER_QUERY);
+            for (size_t i = 0; i < corpus_.queries.size(); ++i) {
+                for (int j = 0; j < MATCHES_PER_QUERY; ++j) {
+                    document_ids[j] = GetMatchedDocumentId(i, j);
+                }
+                recorder.Time([&] {
+                    for (const auto& [words, status] : search_server_.MatchDocuments(policy, corpus_.queries[i], document_ids)) {
+                        matched_count += words.size();
+                    }
+                });
+            }
+            return matched_count;
+        });
+    }
+
+    template <typename ExecutionPolicy>
+    void RunRemoveDocument(string name, ExecutionPolicy policy) {
+        RunIfSelected(move(name), 1, [this, policy](SampleRecorder& recorder) {
+            SearchServer search_server = search_server_;
+            for (const int document_id : GetRemovedDocumentIds()) {
+                recorder.Time([&] {
+                    search_server.RemoveDocument(policy, document_id);
+                });
+            }
+            return static_cast<size_t>(search_server.GetDocumentCount());
+        });
+    }
+
+    template <typename ExecutionPolicy>
+    void RunRemoveDocuments(string name, ExecutionPolicy policy) {
+        const vector<int> document_ids = GetRemovedDocumentIds();
+        RunIfSelected(move(name), document_ids.size(), [this, policy, &document_ids](SampleRecorder& recorder) {
+            SearchServer search_server = search_server_;
+            recorder.Time([&] {
+                search_server.RemoveDocuments(policy, document_ids);
+            });
+            return static_cast<size_t>(search_server.GetDocumentCount());
+        });
+    }
+
+    // Every text of the first half of the corpus is added twice, and one copy in ten gets an extra word
+    void RunRemoveDuplicates(string name, double min_similarity) {
+        vector<RawDocument> documents;
+        for (int i = 0; i < config_.document_count / 2; ++i) {
+            const string& text = corpus_.documents[i].text;
+            documents.push_back({2 * i, text, DocumentStatus::ACTUAL, {1}});
+            documents.push_back({2 * i + 1, i % 10 == 0 ? text + " "s + corpus_.dictionary[i % corpus_.dictionary.size()] : text,
+                                 DocumentStatus::ACTUAL, {1}});
+        }
+        RunIfSelected(move(name), documents.size(), [min_similarity, &documents](SampleRecorder& recorder) {
+            SearchServer search_server;
+            search_server.AddDocuments(execution::par, documents);
+            size_t removed_count = 0;
+            recorder.Time([&] {
+                removed_count = RemoveDuplicates(search_server, min_similarity).size();
+            });
+            return removed_count;
+        });
+    }
+
+    // Requests by status through the result cache
+    void RunRequestQueue() {
+        RunIfSelected("request_queue_cached"s, 1, [this](SampleRecorder& recorder) {
+            RequestQueue request_queue(search_server_);
+            size_t found_count = 0;
+            for (int round = 0; round < CACHED_QUERY_ROUNDS; ++round) {
+                for (const string& query : corpus_.queries) {
+                    recorder.Time([&] {
+                        found_count += request_queue.AddFindRequest(query, DocumentStatus::ACTUAL).size();
+                    });
+                }
+            }
+            return found_count;
+        });
+    }
+
+    // A sample submits all the queries to the worker threads and waits for their results
+    void RunAsyncRequestQueue() {
+        RunIfSelected("async_requests"s, corpus_.queries.size(), [this](SampleRecorder& recorder) {
+            AsyncRequestQueue request_queue(search_server_);
+            vector<future<vector<Document>>> results;
+            results.reserve(corpus_.queries.size());
+            size_t found_count = 0;
+            recorder.Time([&] {
+                for (const string& query : corpus_.queries) {
+                    results.push_back(request_queue.Submit(query));
+                }
+                for (auto& result : results) {
+                    found_count += result.get().size();
+                }
+            });
+            return found_count;
+        });
+    }
+
+    // Query latency while another thread adds documents; the checksum is the final document count
+    template <typename AddDocument, typename FindTopDocuments>
+    void TimeQueriesUnderWrites(SampleRecorder& recorder, AddDocument add_document, FindTopDocuments find_top_documents) const {
+        atomic_bool is_writing = true;
+        thread writer([&] {
+            for (int i = 0; i < DOCUMENTS_ADDED_UNDER_READS; ++i) {
+                const RawDocument& document = corpus_.documents[i % corpus_.documents.size()];
+                add_document(config_.document_count + i, document);
+            }
+            is_writing = false;
+        });
+        for (size_t i = 0; is_writing && !corpus_.queries.empty(); ++i) {
+            recorder.Time([&] {
+                find_top_documents(corpus_.queries[i % corpus_.queries.size()]);
+            });
+        }
+        writer.join();
+    }
+
+    void RunFindTopDocumentsUnderWrites() {
+        RunIfSelected("find_top_writes_mutex"s, 1, [this](SampleRecorder& recorder) {
+            SearchServer search_server = search_server_;
+            mutex server_mutex;
+            TimeQueriesUnderWrites(recorder, [&](int document_id, const RawDocument& document) {
+                lock_guard<mutex> guard(server_mutex);
+                search_server.AddDocument(document_id, document.text, document.status, document.ratings);
+            }, [&](const string& query) {
+                lock_guard<mutex> guard(server_mutex);
+                return search_server.FindTopDocuments(query);
+            });
+            return static_cast<size_t>(search_server.GetDocumentCount());
+        });
+        RunIfSelected("find_top_writes_snapshot"s, 1, [this](SampleRecorder& recorder) {
+            ConcurrentSearchServer search_server(search_server_);
+            TimeQueriesUnderWrites(recorder, [&](int document_id, const RawDocument& document) {
+                search_server.AddDocument(document_id, document.text, document.status, document.ratings);
+            }, [&](const string& query) {
+                return search_server.FindTopDocuments(query);
+            });
+            return static_cast<size_t>(search_server.GetSnapshot()->GetDocumentCount());
+        });
+    }
+
+    // Set operations of each supported kernel on sorted ordinals, as posting runs of two terms over the corpus
+    void RunOrdinalSetOps() {
+        mt19937 generator(config_.seed);
+        vector<int> a;
+        vector<int> b;
+        for (int ordinal = 0; ordinal < config_.document_count; ++ordinal) {
+            if (uniform_real_distribution<>(0, 1)(generator) < 0.5) {
+                a.push_back(ordinal);
+            }
+            if (uniform_real_distribution<>(0, 1)(generator) < 0.3) {
+                b.push_back(ordinal);
+            }
+        }
+        for (const auto& [kernel, kernel_name] : {pair{OrdinalKernel::SCALAR, "scalar"s}, pair{OrdinalKernel::SSE2, "sse2"s},
+                                                  pair{OrdinalKernel::AVX2, "avx2"s}}) {
+            if (!IsOrdinalKernelSupported(kernel)) {
+                continue;
+            }
+            RunIfSelected("intersect_"s + kernel_name, 1, [kernel = kernel, &a, &b](SampleRecorder& recorder) {
+                vector<uint32_t> positions(a.size());
+                size_t count = 0;
+                for (int i = 0; i < SET_OPERATIONS_PER_REPETITION; ++i) {
+                    recorder.Time([&] {
+                        count = IntersectOrdinals(a.data(), a.size(), b.data(), b.size(), positions.data(), kernel);
+                    });
+                }
+                return count;
+            });
+            RunIfSelected("subtract_"s + kernel_name, 1, [kernel = kernel, &a, &b](SampleRecorder& recorder) {
+                vector<uint32_t> positions(a.size());
+                size_t count = 0;
+                for (int i = 0; i < SET_OPERATIONS_PER_REPETITION; ++i) {
+                    recorder.Time([&] {
+                        count = SubtractOrdinals(a.data(), a.size(), b.data(), b.size(), positions.data(), kernel);
+                    });
+                }
+                return count;
+            });
+        }
+    }
+};
+}
+
+int main(int argc, char** argv) {
+    BenchmarkConfig config;
+    if (!ParseConfig(argc, argv, config)) {
+        return 1;
+    }
+    BenchmarkSuite suite(config);
+    PrintResultHeader(cout);
+    const vector<BenchmarkResult> results = suite.Run();
+#ifdef SEARCH_SERVER_INSTRUMENTATION
+    DumpProbeStats(cerr);
+#endif
+    if (!config.json_path.empty()) {
+        ofstream output(config.json_path);
+        WriteJson(output, config, results);
+        if (!output) {
+            cerr << "Cannot write "s << config.json_path << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
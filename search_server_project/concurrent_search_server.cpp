@@ -0,0 +1,90 @@
+#include "concurrent_search_server.h"
+
+#include <thread>
+
+using namespace std;
+
+namespace {
+// Yields of a writer before it sleeps: enough for readers finishing a query
+const int WRITER_SPIN_COUNT = 64;
+}
+
+ConcurrentSearchServer::ConcurrentSearchServer(const SearchServer& search_server)
+    : copies_{make_shared<Copy>(), make_shared<Copy>()} {
+    copies_[0]->search_server.emplace(search_server);
+    copies_[1]->search_server.emplace(search_server);
+}
+
+shared_ptr<const SearchServer> ConcurrentSearchServer::GetSnapshot() const {
+    while (true) {
+        const size_t index = published_index_.load();
+        const shared_ptr<Copy>& copy = copies_[index];
+        copy->reader_count.fetch_add(1);
+        // Both operations are sequentially consistent: if a writer has seen no readers after
+        // switching the copies, the index read here is the new one, and the reader backs off
+        if (published_index_.load() == index) {
+            return shared_ptr<const SearchServer>(&*copy->search_server, [copy](const SearchServer*) {
+                ReleaseReader(*copy);
+            });
+        }
+        ReleaseReader(*copy);
+    }
+}
+
+vector<Document> ConcurrentSearchServer::FindTopDocuments(string_view raw_query) const {
+    return GetSnapshot()->FindTopDocuments(raw_query);
+}
+
+vector<Document> ConcurrentSearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
+    return GetSnapshot()->FindTopDocuments(raw_query, status);
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    Update([&](SearchServer& search_server) {
+        search_server.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+void ConcurrentSearchServer::AddDocuments(const vector<RawDocument>& documents) {
+    Update([&documents](SearchServer& search_server) {
+        search_server.AddDocuments(execution::par, documents);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    Update([&document_ids](SearchServer& search_server) {
+        search_server.RemoveDocuments(execution::par, document_ids);
+    });
+}
+
+void ConcurrentSearchServer::SetDocumentStatus(int document_id, DocumentStatus status) {
+    Update([document_id, status](SearchServer& search_server) {
+        search_server.SetDocumentStatus(document_id, status);
+    });
+}
+
+void ConcurrentSearchServer::ReleaseReader(Copy& copy) {
+    // Both operations are sequentially consistent, as are the writer's flag store and count load:
+    // either the writer sees the count at zero, or the last reader sees the flag and wakes it.
+    // The wake-up is sent under the mutex, so it cannot fall between the writer's check and sleep.
+    if (copy.reader_count.fetch_sub(1) == 1 && copy.has_waiting_writer.load()) {
+        lock_guard<mutex> guard(copy.readers_mutex);
+        copy.readers_released.notify_all();
+    }
+}
+
+void ConcurrentSearchServer::WaitForReaders(Copy& copy) {
+    // Acquire pairs with the release of every reader's count, so their reads of the copy are over
+    for (int i = 0; i < WRITER_SPIN_COUNT; ++i) {
+        if (copy.reader_count.load(memory_order_acquire) == 0) {
+            return;
+        }
+        this_thread::yield();
+    }
+    unique_lock<mutex> lock(copy.readers_mutex);
+    copy.has_waiting_writer.store(true);
+    copy.readers_released.wait(lock, [&copy] {
+        return copy.reader_count.load() == 0;
+    });
+    copy.has_waiting_writer.store(false);
+}
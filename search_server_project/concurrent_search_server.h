@@ -0,0 +1,92 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Lets queries run while documents are added or removed. Two copies of the index are kept
+// (left-right scheme): readers count themselves in on the published copy and never block,
+// while a writer changes the standby copy, publishes it, waits until the reader count of the
+// old copy drops to zero and replays the change there. A writer kept waiting sleeps until the
+// last reader wakes it.
+// Writers are serialized among themselves and pay for every change twice.
+class ConcurrentSearchServer {
+public:
+    explicit ConcurrentSearchServer(const SearchServer& search_server);
+
+    // The snapshot never changes; it stays valid as long as the caller holds it, and the second
+    // half of the next update waits for it to be released. So a thread must not hold a snapshot
+    // while it changes the server, or it waits for itself forever, and a snapshot held for long
+    // stalls every writer.
+    std::shared_ptr<const SearchServer> GetSnapshot() const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    void AddDocuments(const std::vector<RawDocument>& documents);
+
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    void SetDocumentStatus(int document_id, DocumentStatus status);
+
+    // Applies update(SearchServer&) to both copies; it must change them the same way.
+    // If it throws on the first copy, nothing is published and the exception is rethrown.
+    // Blocks until the snapshots taken before are released, so the calling thread must hold none.
+    template <typename Function>
+    void Update(Function update);
+
+private:
+    struct Copy {
+        // Replaced in place when a failed update is rolled back, as readers may be counting
+        // themselves in on the copy at any time
+        std::optional<SearchServer> search_server;
+        std::atomic<size_t> reader_count = 0;
+        // Set while a writer sleeps on readers_released; only then does the last reader take
+        // the mutex to wake it
+        std::atomic<bool> has_waiting_writer = false;
+        std::mutex readers_mutex;
+        std::condition_variable readers_released;
+    };
+
+    static void ReleaseReader(Copy& copy);
+
+    // Waits until no reader uses the copy; the reads of the last reader happen before the return
+    static void WaitForReaders(Copy& copy);
+
+    std::mutex writer_mutex_;
+    // Never replaced; snapshots share them, so they outlive this object while snapshots are held
+    const std::shared_ptr<Copy> copies_[2];
+    std::atomic<size_t> published_index_ = 0;
+};
+
+template <typename Function>
+void ConcurrentSearchServer::Update(Function update) {
+    std::lock_guard<std::mutex> guard(writer_mutex_);
+    const size_t published_index = published_index_.load();
+    Copy& published = *copies_[published_index];
+    Copy& standby = *copies_[1 - published_index];
+    try {
+        update(*standby.search_server);
+    } catch (...) {
+        // The standby copy may be half changed: restore it from the published one
+        standby.search_server.emplace(*published.search_server);
+        throw;
+    }
+    published_index_.store(1 - published_index);
+    WaitForReaders(published);
+    try {
+        update(*published.search_server);
+    } catch (...) {
+        published.search_server.emplace(*standby.search_server);
+        throw;
+    }
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <string>
+#include <vector>
+
 struct Document {
     Document() = default;
 
@@ -15,4 +18,11 @@ enum class DocumentStatus {
     IRRELEVANT,
     BANNED,
     REMOVED,
-};
\ No newline at end of file
+};
+
+struct RawDocument {
+    int id = 0;
+    std::string text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
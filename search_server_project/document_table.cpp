@@ -0,0 +1,111 @@
+#include "document_table.h"
+#include "snapshot_io.h"
+
+#include <limits>
+
+using namespace std;
+
+int DocumentTable::Add(int document_id, int rating, DocumentStatus status, int word_count) {
+    const double inverse_word_count = word_count > 0 ? 1.0 / word_count : 0.0;
+    int ordinal;
+    if (!free_ordinals_.empty()) {
+        ordinal = free_ordinals_.back();
+        free_ordinals_.pop_back();
+        document_ids_[ordinal] = document_id;
+        ratings_[ordinal] = rating;
+        statuses_[ordinal] = status;
+        inverse_word_counts_[ordinal] = inverse_word_count;
+        alive_[ordinal] = true;
+    } else {
+        ordinal = static_cast<int>(document_ids_.size());
+        document_ids_.push_back(document_id);
+        ratings_.push_back(rating);
+        statuses_.push_back(status);
+        inverse_word_counts_.push_back(inverse_word_count);
+        alive_.push_back(true);
+    }
+    id_to_ordinal_.emplace(document_id, ordinal);
+    status_ordinals_[static_cast<size_t>(status)].Set(ordinal);
+    return ordinal;
+}
+
+void DocumentTable::Remove(int ordinal) {
+    id_to_ordinal_.erase(document_ids_[ordinal]);
+    alive_[ordinal] = false;
+    status_ordinals_[static_cast<size_t>(statuses_[ordinal])].Reset(ordinal);
+}
+
+void DocumentTable::Release(int ordinal) {
+    free_ordinals_.push_back(ordinal);
+}
+
+void DocumentTable::SetStatus(int ordinal, DocumentStatus status) {
+    status_ordinals_[static_cast<size_t>(statuses_[ordinal])].Reset(ordinal);
+    statuses_[ordinal] = status;
+    status_ordinals_[static_cast<size_t>(status)].Set(ordinal);
+}
+
+int DocumentTable::FindOrdinal(int document_id) const {
+    const auto it = id_to_ordinal_.find(document_id);
+    if (it == id_to_ordinal_.end()) {
+        return -1;
+    }
+    return it->second;
+}
+
+int DocumentTable::GetDocumentCount() const {
+    return static_cast<int>(id_to_ordinal_.size());
+}
+
+int DocumentTable::GetOrdinalCount() const {
+    return static_cast<int>(document_ids_.size());
+}
+
+void DocumentTable::WriteSnapshot(SnapshotWriter& writer) const {
+    writer.Write<uint64_t>(document_ids_.size());
+    writer.WriteArray(document_ids_.data(), document_ids_.size());
+    writer.WriteArray(ratings_.data(), ratings_.size());
+    writer.WriteArray(statuses_.data(), statuses_.size());
+    writer.WriteArray(inverse_word_counts_.data(), inverse_word_counts_.size());
+    writer.WriteArray(alive_.data(), alive_.size());
+    writer.Write<uint64_t>(free_ordinals_.size());
+    writer.WriteArray(free_ordinals_.data(), free_ordinals_.size());
+}
+
+void DocumentTable::ReadSnapshot(SnapshotReader& reader) {
+    const size_t ordinal_count = reader.Read<uint64_t>();
+    CheckSnapshot(ordinal_count <= static_cast<size_t>(numeric_limits<int>::max()));
+    const int* document_ids = reader.ReadArray<int>(ordinal_count);
+    document_ids_.assign(document_ids, document_ids + ordinal_count);
+    const int* ratings = reader.ReadArray<int>(ordinal_count);
+    ratings_.assign(ratings, ratings + ordinal_count);
+    const DocumentStatus* statuses = reader.ReadArray<DocumentStatus>(ordinal_count);
+    statuses_.assign(statuses, statuses + ordinal_count);
+    for (const DocumentStatus status : statuses_) {
+        CheckSnapshot(status >= DocumentStatus::ACTUAL && status <= DocumentStatus::REMOVED);
+    }
+    const double* inverse_word_counts = reader.ReadArray<double>(ordinal_count);
+    inverse_word_counts_.assign(inverse_word_counts, inverse_word_counts + ordinal_count);
+    for (const double inverse_word_count : inverse_word_counts_) {
+        CheckSnapshot(inverse_word_count >= 0.0 && inverse_word_count <= 1.0);
+    }
+    const char* alive = reader.ReadArray<char>(ordinal_count);
+    alive_.assign(alive, alive + ordinal_count);
+    const size_t free_ordinal_count = reader.Read<uint64_t>();
+    const int* free_ordinals = reader.ReadArray<int>(free_ordinal_count);
+    free_ordinals_.assign(free_ordinals, free_ordinals + free_ordinal_count);
+    for (const int ordinal : free_ordinals_) {
+        CheckSnapshot(ordinal >= 0 && static_cast<size_t>(ordinal) < ordinal_count && !alive_[ordinal]);
+    }
+    id_to_ordinal_.clear();
+    id_to_ordinal_.reserve(ordinal_count);
+    for (OrdinalBitmap& ordinals : status_ordinals_) {
+        ordinals.Clear();
+    }
+    for (size_t ordinal = 0; ordinal < ordinal_count; ++ordinal) {
+        if (alive_[ordinal]) {
+            CheckSnapshot(id_to_ordinal_.emplace(document_ids_[ordinal], static_cast<int>(ordinal)).second);
+            status_ordinals_[static_cast<size_t>(statuses_[ordinal])].Set(static_cast<int>(ordinal));
+        }
+    }
+}
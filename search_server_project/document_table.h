@@ -0,0 +1,80 @@
+#pragma once
+
+#include "document.h"
+#include "ordinal_bitmap.h"
+
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Document attributes laid out as parallel arrays indexed by a dense internal ordinal.
+// External document ids are mapped to ordinals once on insertion; removed ordinals are
+// tombstoned and, once released, handed out again to later documents. Alive documents are
+// also kept in a bitmap per status, so queries for one status skip the others wholesale.
+class DocumentTable {
+public:
+    // word_count counts the document's words other than stop words
+    int Add(int document_id, int rating, DocumentStatus status, int word_count);
+
+    // The document disappears at once, but its ordinal is not reused before Release
+    void Remove(int ordinal);
+
+    void Release(int ordinal);
+
+    // Returns -1 if there is no document with such id
+    int FindOrdinal(int document_id) const;
+
+    bool IsAlive(int ordinal) const {
+        return alive_[ordinal];
+    }
+
+    int GetDocumentId(int ordinal) const {
+        return document_ids_[ordinal];
+    }
+
+    int GetRating(int ordinal) const {
+        return ratings_[ordinal];
+    }
+
+    DocumentStatus GetStatus(int ordinal) const {
+        return statuses_[ordinal];
+    }
+
+    // Moves an alive document to the bitmap of the new status
+    void SetStatus(int ordinal, DocumentStatus status);
+
+    // Alive documents with the status
+    const OrdinalBitmap& GetStatusOrdinals(DocumentStatus status) const {
+        return status_ordinals_[static_cast<size_t>(status)];
+    }
+
+    // Postings keep term counts rather than frequencies, which take one division per document
+    double GetTermFreq(int ordinal, int term_count) const {
+        return term_count * inverse_word_counts_[ordinal];
+    }
+
+    double GetInverseWordCount(int ordinal) const {
+        return inverse_word_counts_[ordinal];
+    }
+
+    int GetDocumentCount() const;
+
+    int GetOrdinalCount() const;
+
+    void WriteSnapshot(SnapshotWriter& writer) const;
+
+    void ReadSnapshot(SnapshotReader& reader);
+
+private:
+    std::unordered_map<int, int> id_to_ordinal_;
+    std::vector<int> document_ids_;
+    std::vector<int> ratings_;
+    std::vector<DocumentStatus> statuses_;
+    std::vector<double> inverse_word_counts_;
+    std::vector<char> alive_;
+    std::vector<int> free_ordinals_;
+    std::array<OrdinalBitmap, static_cast<size_t>(DocumentStatus::REMOVED) + 1> status_ordinals_;
+};
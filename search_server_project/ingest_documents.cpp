@@ -0,0 +1,75 @@
+#include "ingest_documents.h"
+#include "bounded_queue.h"
+#include "json_lines_reader.h"
+
+#include <chrono>
+#include <exception>
+#include <execution>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+double IngestStats::GetDocumentsPerSecond() const {
+    return seconds > 0.0 ? document_count / seconds : 0.0;
+}
+
+double IngestStats::GetMegabytesPerSecond() const {
+    return seconds > 0.0 ? byte_count / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+ostream& operator<<(ostream& output, const IngestStats& stats) {
+    return output << stats.document_count << " documents, "s << stats.byte_count << " bytes in "s << stats.seconds << " s: "s
+                  << stats.GetDocumentsPerSecond() << " docs/s, "s << stats.GetMegabytesPerSecond() << " MB/s"s;
+}
+
+IngestStats IngestDocuments(SearchServer& search_server, istream& input, size_t batch_size, size_t queue_capacity) {
+    const auto start_time = chrono::steady_clock::now();
+    batch_size = max<size_t>(batch_size, 1);
+    BoundedQueue<vector<RawDocument>> batches(max<size_t>(queue_capacity, 1));
+    JsonLinesReader reader(input);
+    exception_ptr producer_error;
+
+    thread producer([&] {
+        try {
+            vector<RawDocument> batch;
+            batch.reserve(batch_size);
+            RawDocument document;
+            while (reader.Read(document)) {
+                batch.push_back(move(document));
+                if (batch.size() == batch_size) {
+                    if (!batches.Push(move(batch))) {
+                        return;
+                    }
+                    batch.clear();
+                    batch.reserve(batch_size);
+                }
+            }
+            if (!batch.empty()) {
+                batches.Push(move(batch));
+            }
+        } catch (...) {
+            producer_error = current_exception();
+        }
+        batches.Close();
+    });
+
+    IngestStats stats;
+    try {
+        while (auto batch = batches.Pop()) {
+            search_server.AddDocuments(execution::par, *batch);
+            stats.document_count += batch->size();
+        }
+    } catch (...) {
+        batches.Close();
+        producer.join();
+        throw;
+    }
+    producer.join();
+    if (producer_error) {
+        rethrow_exception(producer_error);
+    }
+    stats.byte_count = reader.GetByteCount();
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+    return stats;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <istream>
+#include <ostream>
+
+struct IngestStats {
+    size_t document_count = 0;
+    size_t byte_count = 0;
+    double seconds = 0.0;
+
+    double GetDocumentsPerSecond() const;
+
+    double GetMegabytesPerSecond() const;
+};
+
+std::ostream& operator<<(std::ostream& output, const IngestStats& stats);
+
+// Streams JSON-lines documents (see JsonLinesReader) into the server. A producer thread parses
+// batches of batch_size documents while the calling thread indexes earlier batches with
+// AddDocuments(par); at most queue_capacity parsed batches wait in between, so memory stays
+// bounded for inputs of any size. A malformed line or a rejected batch stops the ingestion and
+// its exception is rethrown; batches indexed before it stay in the server.
+IngestStats IngestDocuments(SearchServer& search_server, std::istream& input, size_t batch_size = 4096, size_t queue_capacity = 4);
@@ -0,0 +1,191 @@
+#include "instrumentation.h"
+#include "log_linear_buckets.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+
+using namespace std;
+
+namespace {
+constexpr size_t SUB_BUCKET_BITS = 2;
+constexpr size_t BUCKET_COUNT = LOG_LINEAR_BUCKET_COUNT<SUB_BUCKET_BITS>;
+
+// Written by one thread only, read by collectors, hence atomics without read-modify-write
+struct ProbeCounters {
+    atomic<uint64_t> count{0};
+    atomic<uint64_t> total{0};
+    atomic<uint64_t> max{0};
+    array<atomic<uint64_t>, BUCKET_COUNT> buckets{};
+};
+
+using ThreadProbes = array<ProbeCounters, Probe::MAX_PROBE_COUNT>;
+
+void AddRelaxed(atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+void AddCounters(const ProbeCounters& from, ProbeCounters& to) {
+    AddRelaxed(to.count, from.count.load(memory_order_relaxed));
+    AddRelaxed(to.total, from.total.load(memory_order_relaxed));
+    to.max.store(std::max(to.max.load(memory_order_relaxed), from.max.load(memory_order_relaxed)), memory_order_relaxed);
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        AddRelaxed(to.buckets[bucket], from.buckets[bucket].load(memory_order_relaxed));
+    }
+}
+
+struct Registry {
+    mutex state_mutex;
+    vector<string> names;
+    vector<const ThreadProbes*> threads;
+    // Stats of threads which have exited
+    ThreadProbes retired;
+};
+
+// Never destroyed, so threads exiting after main still find it
+Registry& GetRegistry() {
+    static Registry* registry = new Registry();
+    return *registry;
+}
+
+// Hands the stats of the thread over to the registry when the thread exits
+struct ThreadProbesOwner {
+    unique_ptr<ThreadProbes> probes;
+
+    ~ThreadProbesOwner() {
+        if (!probes) {
+            return;
+        }
+        Registry& registry = GetRegistry();
+        lock_guard<mutex> guard(registry.state_mutex);
+        for (size_t id = 0; id < Probe::MAX_PROBE_COUNT; ++id) {
+            AddCounters((*probes)[id], registry.retired[id]);
+        }
+        registry.threads.erase(find(registry.threads.begin(), registry.threads.end(), probes.get()));
+    }
+};
+
+ThreadProbes& GetThreadProbes() {
+    thread_local ThreadProbesOwner owner;
+    if (!owner.probes) {
+        owner.probes = make_unique<ThreadProbes>();
+        Registry& registry = GetRegistry();
+        lock_guard<mutex> guard(registry.state_mutex);
+        registry.threads.push_back(owner.probes.get());
+    }
+    return *owner.probes;
+}
+
+uint64_t GetPercentile(const ProbeCounters& counters, double percentile) {
+    const uint64_t count = counters.count.load(memory_order_relaxed);
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t rank = min(count - 1, static_cast<uint64_t>(percentile * count));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        seen += counters.buckets[bucket].load(memory_order_relaxed);
+        if (seen > rank) {
+            return min(GetLogLinearBucketLimit<SUB_BUCKET_BITS>(bucket), counters.max.load(memory_order_relaxed));
+        }
+    }
+    return counters.max.load(memory_order_relaxed);
+}
+
+void WriteJsonString(ostream& output, const string& text) {
+    output << '"';
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            output << '\\';
+        }
+        output << c;
+    }
+    output << '"';
+}
+}
+
+Probe::Probe(const char* name) {
+    Registry& registry = GetRegistry();
+    lock_guard<mutex> guard(registry.state_mutex);
+    id_ = find(registry.names.begin(), registry.names.end(), name) - registry.names.begin();
+    if (id_ == registry.names.size() && id_ < MAX_PROBE_COUNT) {
+        registry.names.push_back(name);
+    }
+}
+
+void Probe::Record(uint64_t value) const {
+    if (id_ >= MAX_PROBE_COUNT) {
+        return;
+    }
+    ProbeCounters& counters = GetThreadProbes()[id_];
+    AddRelaxed(counters.count, 1);
+    AddRelaxed(counters.total, value);
+    if (value > counters.max.load(memory_order_relaxed)) {
+        counters.max.store(value, memory_order_relaxed);
+    }
+    AddRelaxed(counters.buckets[GetLogLinearBucket<SUB_BUCKET_BITS>(value)], 1);
+}
+
+vector<ProbeStats> CollectProbeStats() {
+    Registry& registry = GetRegistry();
+    lock_guard<mutex> guard(registry.state_mutex);
+    vector<ProbeStats> stats;
+    ProbeCounters counters;
+    for (size_t id = 0; id < registry.names.size(); ++id) {
+        counters.count = 0;
+        counters.total = 0;
+        counters.max = 0;
+        for (auto& bucket : counters.buckets) {
+            bucket = 0;
+        }
+        AddCounters(registry.retired[id], counters);
+        for (const ThreadProbes* probes : registry.threads) {
+            AddCounters((*probes)[id], counters);
+        }
+        stats.push_back({registry.names[id], counters.count, counters.total, GetPercentile(counters, 0.5), GetPercentile(counters, 0.99),
+                         counters.max});
+    }
+    return stats;
+}
+
+void DumpProbeStats(ostream& output, ProbeFormat format) {
+    const vector<ProbeStats> stats = CollectProbeStats();
+    if (format == ProbeFormat::JSON) {
+        output << "{\"probes\":[";
+        for (size_t i = 0; i < stats.size(); ++i) {
+            output << (i > 0 ? "," : "") << "{\"name\":";
+            WriteJsonString(output, stats[i].name);
+            output << ",\"count\":" << stats[i].count << ",\"total\":" << stats[i].total << ",\"p50\":" << stats[i].p50
+                   << ",\"p99\":" << stats[i].p99 << ",\"max\":" << stats[i].max << '}';
+        }
+        output << "]}\n";
+        return;
+    }
+    for (const ProbeStats& probe : stats) {
+        output << probe.name << ": " << probe.count << " calls, total " << probe.total << ", mean "
+               << (probe.count > 0 ? probe.total / probe.count : 0) << ", p50 " << probe.p50 << ", p99 " << probe.p99 << ", max "
+               << probe.max << '\n';
+    }
+    output.flush();
+}
+
+PeriodicProbeDump::PeriodicProbeDump(ostream& output, chrono::milliseconds interval, ProbeFormat format)
+    : thread_([this, &output, interval, format] {
+        unique_lock<mutex> lock(mutex_);
+        while (!stop_requested_.wait_for(lock, interval, [this] {
+            return is_stopped_;
+        })) {
+            DumpProbeStats(output, format);
+        }
+    }) {
+}
+
+PeriodicProbeDump::~PeriodicProbeDump() {
+    {
+        lock_guard<mutex> guard(mutex_);
+        is_stopped_ = true;
+    }
+    stop_requested_.notify_all();
+    thread_.join();
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Named probes on hot paths. Every thread records into counters and a log-linear histogram of
+// its own, which only it writes, so recording takes a few relaxed stores and no lock; collecting
+// sums the threads. A scoped timer records its duration in nanoseconds.
+// The PROBE_* macros compile to nothing unless SEARCH_SERVER_INSTRUMENTATION is defined.
+
+struct ProbeStats {
+    std::string name;
+    uint64_t count = 0;
+    // Sum, percentiles and maximum of the recorded values, nanoseconds for timers.
+    // Percentiles are bucket limits, up to 1/4 above the true ones.
+    uint64_t total = 0;
+    uint64_t p50 = 0;
+    uint64_t p99 = 0;
+    uint64_t max = 0;
+};
+
+enum class ProbeFormat {
+    TEXT,
+    JSON,
+};
+
+class Probe {
+public:
+    // At most MAX_PROBE_COUNT distinct names are recorded; probes of one name share their stats
+    static constexpr size_t MAX_PROBE_COUNT = 32;
+
+    explicit Probe(const char* name);
+
+    void Record(uint64_t value) const;
+
+private:
+    size_t id_;
+};
+
+class ProbeTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit ProbeTimer(const Probe& probe)
+        : probe_(probe) {
+    }
+
+    ~ProbeTimer() {
+        probe_.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_time_).count());
+    }
+
+private:
+    const Probe& probe_;
+    const Clock::time_point start_time_ = Clock::now();
+};
+
+// Stats of every probe recorded so far, including threads which have exited, in the order
+// the probes were first met
+std::vector<ProbeStats> CollectProbeStats();
+
+void DumpProbeStats(std::ostream& output, ProbeFormat format = ProbeFormat::TEXT);
+
+// Dumps the stats of all probes every interval from a thread of its own
+class PeriodicProbeDump {
+public:
+    PeriodicProbeDump(std::ostream& output, std::chrono::milliseconds interval, ProbeFormat format = ProbeFormat::TEXT);
+
+    PeriodicProbeDump(const PeriodicProbeDump&) = delete;
+
+    PeriodicProbeDump& operator=(const PeriodicProbeDump&) = delete;
+
+    ~PeriodicProbeDump();
+
+private:
+    std::mutex mutex_;
+    std::condition_variable stop_requested_;
+    bool is_stopped_ = false;
+    std::thread thread_;
+};
+
+#define PROBE_CONCAT_INTERNAL(X, Y) X##Y
+#define PROBE_CONCAT(X, Y) PROBE_CONCAT_INTERNAL(X, Y)
+
+#ifdef SEARCH_SERVER_INSTRUMENTATION
+// Times the rest of the enclosing scope
+#define PROBE_SCOPE(name)                                      \
+    static const Probe PROBE_CONCAT(probe, __LINE__)(name); \
+    const ProbeTimer PROBE_CONCAT(probe_timer, __LINE__)(PROBE_CONCAT(probe, __LINE__))
+// Records a value, such as the size of a batch
+#define PROBE_RECORD(name, value)          \
+    do {                                   \
+        static const Probe probe(name);    \
+        probe.Record(value);               \
+    } while (false)
+#else
+#define PROBE_SCOPE(name)
+#define PROBE_RECORD(name, value) \
+    do {                          \
+    } while (false)
+#endif
@@ -0,0 +1,441 @@
+#include "inverted_index.h"
+#include "snapshot_io.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+
+using namespace std;
+
+// Shared with the merger thread, which outlives neither the index nor its moves
+struct InvertedIndex::MergeState {
+    mutex m;
+    condition_variable changed;
+    // Replaced under the mutex with atomic_store, so queries may load it without locking
+    shared_ptr<const SegmentList> segments = make_shared<const SegmentList>();
+    // Removed ordinals which still have postings in segments
+    vector<int> removed_ordinals;
+    vector<int> purged_ordinals;
+    size_t tier_base = DEFAULT_BUFFER_LIMIT;
+    bool is_merging = false;
+    bool is_stopped = false;
+};
+
+namespace {
+size_t GetTier(const Segment& segment, size_t tier_base) {
+    size_t tier = 0;
+    for (size_t bound = tier_base * InvertedIndex::MERGE_FACTOR; segment.GetPostingCount() >= bound; bound *= InvertedIndex::MERGE_FACTOR) {
+        ++tier;
+    }
+    return tier;
+}
+
+// Returns the oldest MERGE_FACTOR segments of the lowest tier which has that many
+SegmentList PickMerge(const SegmentList& segments, size_t tier_base) {
+    vector<SegmentList> tiers;
+    for (const auto& segment : segments) {
+        const size_t tier = GetTier(*segment, tier_base);
+        if (tier >= tiers.size()) {
+            tiers.resize(tier + 1);
+        }
+        tiers[tier].push_back(segment);
+        if (tiers[tier].size() == InvertedIndex::MERGE_FACTOR) {
+            return tiers[tier];
+        }
+    }
+    return {};
+}
+
+// The merged segment takes the place of the first input
+SegmentList ReplaceSegments(const SegmentList& segments, const SegmentList& inputs, shared_ptr<const Segment> merged) {
+    SegmentList result;
+    for (const auto& segment : segments) {
+        if (find(inputs.begin(), inputs.end(), segment) == inputs.end()) {
+            result.push_back(segment);
+        } else if (merged) {
+            result.push_back(move(merged));
+        }
+    }
+    return result;
+}
+
+vector<int> SortedCopy(vector<int> values) {
+    sort(values.begin(), values.end());
+    return values;
+}
+
+void EraseValues(vector<int>& values, vector<int> erased) {
+    sort(erased.begin(), erased.end());
+    values.erase(remove_if(values.begin(), values.end(), [&erased](int value) {
+        return binary_search(erased.begin(), erased.end(), value);
+    }), values.end());
+}
+}
+
+void PostingList::Add(int ordinal, int term_count) {
+    if (ordinals_.empty() || ordinals_.back() < ordinal) {
+        ordinals_.push_back(ordinal);
+        term_counts_.push_back(static_cast<uint32_t>(term_count));
+        return;
+    }
+    const auto it = lower_bound(ordinals_.begin(), ordinals_.end(), ordinal);
+    const auto pos = it - ordinals_.begin();
+    if (it != ordinals_.end() && *it == ordinal) {
+        term_counts_[pos] = static_cast<uint32_t>(term_count);
+        return;
+    }
+    ordinals_.insert(it, ordinal);
+    term_counts_.insert(term_counts_.begin() + pos, static_cast<uint32_t>(term_count));
+}
+
+bool PostingList::Contains(int ordinal) const {
+    return binary_search(ordinals_.begin(), ordinals_.end(), ordinal);
+}
+
+size_t PostingList::size() const {
+    return ordinals_.size();
+}
+
+bool PostingList::empty() const {
+    return ordinals_.empty();
+}
+
+InvertedIndex::CachedInverseDocumentFreq::CachedInverseDocumentFreq(const CachedInverseDocumentFreq& other)
+    : value(other.value.load(memory_order_relaxed))
+    , document_count(other.document_count.load(memory_order_relaxed)) {
+}
+
+InvertedIndex::CachedInverseDocumentFreq& InvertedIndex::CachedInverseDocumentFreq::operator=(const CachedInverseDocumentFreq& other) {
+    value.store(other.value.load(memory_order_relaxed), memory_order_relaxed);
+    document_count.store(other.document_count.load(memory_order_relaxed), memory_order_relaxed);
+    return *this;
+}
+
+InvertedIndex::InvertedIndex()
+    : merge_state_(make_shared<MergeState>()) {
+}
+
+// The copy shares the immutable segments and starts its own merger once it flushes
+InvertedIndex::InvertedIndex(const InvertedIndex& other)
+    : terms_(other.terms_)
+    , document_freqs_(other.document_freqs_)
+    , term_freq_bounds_(other.term_freq_bounds_)
+    , inverse_document_freqs_(other.inverse_document_freqs_)
+    , buffer_(other.buffer_)
+    , buffer_term_ids_(other.buffer_term_ids_)
+    , buffer_posting_count_(other.buffer_posting_count_)
+    , buffer_limit_(other.buffer_limit_)
+    , merge_state_(make_shared<MergeState>()) {
+    lock_guard guard(other.merge_state_->m);
+    merge_state_->segments = atomic_load(&other.merge_state_->segments);
+    merge_state_->removed_ordinals = other.merge_state_->removed_ordinals;
+    merge_state_->purged_ordinals = other.merge_state_->purged_ordinals;
+    merge_state_->tier_base = other.merge_state_->tier_base;
+}
+
+InvertedIndex::~InvertedIndex() {
+    if (merger_.joinable()) {
+        {
+            lock_guard guard(merge_state_->m);
+            merge_state_->is_stopped = true;
+        }
+        merge_state_->changed.notify_all();
+        merger_.join();
+    }
+}
+
+int InvertedIndex::AddPosting(string_view term, int ordinal, int term_count) {
+    const int term_id = InternTerm(term);
+    if (buffer_[term_id].empty()) {
+        buffer_term_ids_.push_back(term_id);
+    }
+    buffer_[term_id].Add(ordinal, term_count);
+    AddDocumentFreq(term_id, 1);
+    ++buffer_posting_count_;
+    return term_id;
+}
+
+int InvertedIndex::AddPostings(string_view term, const vector<pair<int, int>>& postings) {
+    const int term_id = InternTerm(term);
+    if (buffer_[term_id].empty() && !postings.empty()) {
+        buffer_term_ids_.push_back(term_id);
+    }
+    for (const auto& [ordinal, term_count] : postings) {
+        buffer_[term_id].Add(ordinal, term_count);
+    }
+    AddDocumentFreq(term_id, static_cast<int>(postings.size()));
+    buffer_posting_count_ += postings.size();
+    return term_id;
+}
+
+void InvertedIndex::FlushBufferIfFull() {
+    if (buffer_posting_count_ < buffer_limit_) {
+        return;
+    }
+    auto segment = FreezeBuffer();
+    ClearBuffer();
+    if (!segment) {
+        return;
+    }
+    {
+        lock_guard guard(merge_state_->m);
+        auto segments = make_shared<SegmentList>(*atomic_load(&merge_state_->segments));
+        segments->push_back(move(segment));
+        atomic_store(&merge_state_->segments, shared_ptr<const SegmentList>(move(segments)));
+    }
+    merge_state_->changed.notify_all();
+    if (!merger_.joinable()) {
+        merger_ = thread(RunMerger, merge_state_);
+    }
+}
+
+void InvertedIndex::SetBufferLimit(size_t posting_count) {
+    buffer_limit_ = max<size_t>(1, posting_count);
+    lock_guard guard(merge_state_->m);
+    merge_state_->tier_base = buffer_limit_;
+}
+
+bool InvertedIndex::RetireDocument(int ordinal, const vector<pair<int, double>>& document_terms) {
+    for (const auto& [term_id, _] : document_terms) {
+        AddDocumentFreq(term_id, -1);
+    }
+    if (document_terms.empty() || buffer_[document_terms.front().first].Contains(ordinal)) {
+        return true;
+    }
+    lock_guard guard(merge_state_->m);
+    merge_state_->removed_ordinals.push_back(ordinal);
+    return false;
+}
+
+vector<int> InvertedIndex::TakePurgedOrdinals() {
+    lock_guard guard(merge_state_->m);
+    return exchange(merge_state_->purged_ordinals, {});
+}
+
+void InvertedIndex::ReleaseTermIfUnused(int term_id) {
+    if (document_freqs_[term_id] > 0 || terms_.GetTerm(term_id).empty()) {
+        return;
+    }
+    // A segment still holding postings of removed documents keeps the id from being reused
+    const auto segments = GetSegments();
+    for (const auto& segment : *segments) {
+        if (segment->HasTerm(term_id)) {
+            return;
+        }
+    }
+    buffer_[term_id] = PostingList();
+    terms_.Release(term_id);
+}
+
+int InvertedIndex::FindTermId(string_view term) const {
+    return terms_.Find(term);
+}
+
+double InvertedIndex::GetInverseDocumentFreq(int term_id, int document_count) const {
+    CachedInverseDocumentFreq& cached = inverse_document_freqs_[term_id];
+    if (cached.document_count.load(memory_order_acquire) == document_count) {
+        return cached.value.load(memory_order_relaxed);
+    }
+    const double value = log(document_count * 1.0 / document_freqs_[term_id]);
+    cached.value.store(value, memory_order_relaxed);
+    cached.document_count.store(document_count, memory_order_release);
+    return value;
+}
+
+void InvertedIndex::RaiseTermFreqBound(int term_id, int term_count, double inverse_word_count) {
+    TermFreqBound& bound = term_freq_bounds_[term_id];
+    bound.max_term_freq = max(bound.max_term_freq, term_count * inverse_word_count);
+    bound.max_inverse_word_count = max(bound.max_inverse_word_count, inverse_word_count);
+}
+
+shared_ptr<const SegmentList> InvertedIndex::GetSegments() const {
+    return atomic_load(&merge_state_->segments);
+}
+
+size_t InvertedIndex::GetTermCount() const {
+    return terms_.GetTermCount();
+}
+
+size_t InvertedIndex::GetSegmentCount() const {
+    return GetSegments()->size();
+}
+
+size_t InvertedIndex::GetPostingByteCount() const {
+    size_t byte_count = 0;
+    for (const PostingList& postings : buffer_) {
+        byte_count += postings.size() * (sizeof(int) + sizeof(uint32_t));
+    }
+    for (const auto& segment : *GetSegments()) {
+        byte_count += segment->GetByteCount();
+    }
+    return byte_count;
+}
+
+void InvertedIndex::Compact() {
+    {
+        unique_lock lock(merge_state_->m);
+        merge_state_->changed.wait(lock, [this] {
+            return !merge_state_->is_merging;
+        });
+        SegmentList segments = *atomic_load(&merge_state_->segments);
+        if (auto segment = FreezeBuffer()) {
+            segments.push_back(move(segment));
+        }
+        auto& removed_ordinals = merge_state_->removed_ordinals;
+        vector<int> purged_ordinals;
+        auto merged = MergeSegments(segments, SortedCopy(removed_ordinals), purged_ordinals);
+        atomic_store(&merge_state_->segments, make_shared<const SegmentList>(merged ? SegmentList{move(merged)} : SegmentList{}));
+        EraseValues(removed_ordinals, purged_ordinals);
+        merge_state_->purged_ordinals.insert(merge_state_->purged_ordinals.end(), purged_ordinals.begin(), purged_ordinals.end());
+    }
+    ClearBuffer();
+    for (int term_id = 0; term_id < terms_.GetIdCount(); ++term_id) {
+        if (document_freqs_[term_id] == 0 && !terms_.GetTerm(term_id).empty()) {
+            terms_.Release(term_id);
+        }
+    }
+    terms_.Compact();
+}
+
+void InvertedIndex::WriteSnapshot(SnapshotWriter& writer) const {
+    SegmentList segments;
+    vector<int> removed_ordinals;
+    vector<int> purged_ordinals;
+    {
+        lock_guard guard(merge_state_->m);
+        segments = *atomic_load(&merge_state_->segments);
+        removed_ordinals = SortedCopy(merge_state_->removed_ordinals);
+        purged_ordinals = merge_state_->purged_ordinals;
+    }
+    if (auto segment = FreezeBuffer()) {
+        segments.push_back(move(segment));
+    }
+    const auto merged = MergeSegments(segments, removed_ordinals, purged_ordinals);
+
+    const int id_count = terms_.GetIdCount();
+    vector<uint32_t> term_sizes(id_count);
+    for (int term_id = 0; term_id < id_count; ++term_id) {
+        term_sizes[term_id] = static_cast<uint32_t>(terms_.GetTerm(term_id).size());
+    }
+    writer.Write<uint64_t>(id_count);
+    writer.WriteArray(term_sizes.data(), term_sizes.size());
+    for (int term_id = 0; term_id < id_count; ++term_id) {
+        writer.WriteBytes(terms_.GetTerm(term_id));
+    }
+    writer.WriteArray(document_freqs_.data(), document_freqs_.size());
+    writer.WriteArray(term_freq_bounds_.data(), term_freq_bounds_.size());
+    writer.Write<uint32_t>(merged ? 1 : 0);
+    if (merged) {
+        merged->WriteSnapshot(writer);
+    }
+    // Removed documents whose postings are left out, so the loaded index may reuse their ordinals
+    writer.Write<uint64_t>(purged_ordinals.size());
+    writer.WriteArray(purged_ordinals.data(), purged_ordinals.size());
+}
+
+void InvertedIndex::ReadSnapshot(SnapshotReader& reader, int ordinal_count) {
+    const size_t id_count = reader.Read<uint64_t>();
+    CheckSnapshot(id_count <= static_cast<size_t>(numeric_limits<int>::max()));
+    const uint32_t* term_sizes = reader.ReadArray<uint32_t>(id_count);
+    vector<string_view> terms(id_count);
+    for (size_t term_id = 0; term_id < id_count; ++term_id) {
+        terms[term_id] = reader.ReadBytes(term_sizes[term_id]);
+    }
+    const int* document_freqs = reader.ReadArray<int>(id_count);
+    const TermFreqBound* term_freq_bounds = reader.ReadArray<TermFreqBound>(id_count);
+    for (size_t term_id = 0; term_id < id_count; ++term_id) {
+        CheckSnapshot(document_freqs[term_id] >= 0 && document_freqs[term_id] <= ordinal_count);
+        CheckSnapshot(term_freq_bounds[term_id].max_term_freq >= 0.0 && isfinite(term_freq_bounds[term_id].max_term_freq));
+        CheckSnapshot(term_freq_bounds[term_id].max_inverse_word_count >= 0.0 && term_freq_bounds[term_id].max_inverse_word_count <= 1.0);
+    }
+    SegmentList segments;
+    if (reader.Read<uint32_t>() != 0) {
+        segments.push_back(Segment::ReadSnapshot(reader, static_cast<int>(id_count), ordinal_count));
+    }
+    const size_t purged_count = reader.Read<uint64_t>();
+    const int* purged_ordinals = reader.ReadArray<int>(purged_count);
+    for (size_t i = 0; i < purged_count; ++i) {
+        CheckSnapshot(purged_ordinals[i] >= 0 && purged_ordinals[i] < ordinal_count);
+    }
+
+    terms_.Adopt(terms);
+    document_freqs_.assign(document_freqs, document_freqs + id_count);
+    term_freq_bounds_.assign(term_freq_bounds, term_freq_bounds + id_count);
+    inverse_document_freqs_.assign(id_count, {});
+    buffer_.assign(id_count, {});
+    buffer_term_ids_.clear();
+    buffer_posting_count_ = 0;
+    lock_guard guard(merge_state_->m);
+    atomic_store(&merge_state_->segments, make_shared<const SegmentList>(move(segments)));
+    merge_state_->removed_ordinals.clear();
+    merge_state_->purged_ordinals.assign(purged_ordinals, purged_ordinals + purged_count);
+}
+
+int InvertedIndex::InternTerm(string_view term) {
+    const int term_id = terms_.Intern(term);
+    if (term_id == static_cast<int>(buffer_.size())) {
+        buffer_.emplace_back();
+        document_freqs_.push_back(0);
+        term_freq_bounds_.emplace_back();
+        inverse_document_freqs_.emplace_back();
+    } else if (document_freqs_[term_id] == 0) {
+        // Only removed documents may still have postings of the term, and they are never scored
+        term_freq_bounds_[term_id] = {};
+    }
+    return term_id;
+}
+
+void InvertedIndex::AddDocumentFreq(int term_id, int delta) {
+    document_freqs_[term_id] += delta;
+    inverse_document_freqs_[term_id].document_count.store(-1, memory_order_relaxed);
+}
+
+shared_ptr<const Segment> InvertedIndex::FreezeBuffer() const {
+    vector<int> term_ids = SortedCopy(buffer_term_ids_);
+    term_ids.erase(unique(term_ids.begin(), term_ids.end()), term_ids.end());
+    Segment::Builder builder;
+    for (const int term_id : term_ids) {
+        const PostingRun run = buffer_[term_id].GetRun();
+        builder.AddTerm(term_id, run.ordinals, run.term_counts, run.size);
+    }
+    return builder.Build();
+}
+
+void InvertedIndex::ClearBuffer() {
+    for (const int term_id : buffer_term_ids_) {
+        buffer_[term_id] = PostingList();
+    }
+    buffer_term_ids_.clear();
+    buffer_posting_count_ = 0;
+}
+
+void InvertedIndex::RunMerger(shared_ptr<MergeState> state) {
+    unique_lock lock(state->m);
+    while (true) {
+        SegmentList inputs;
+        state->changed.wait(lock, [&] {
+            if (!state->is_stopped) {
+                inputs = PickMerge(*atomic_load(&state->segments), state->tier_base);
+            }
+            return state->is_stopped || !inputs.empty();
+        });
+        if (state->is_stopped) {
+            return;
+        }
+        const vector<int> removed_ordinals = SortedCopy(state->removed_ordinals);
+        state->is_merging = true;
+        lock.unlock();
+
+        vector<int> purged_ordinals;
+        auto merged = MergeSegments(inputs, removed_ordinals, purged_ordinals);
+
+        lock.lock();
+        atomic_store(&state->segments, make_shared<const SegmentList>(ReplaceSegments(*atomic_load(&state->segments), inputs, move(merged))));
+        EraseValues(state->removed_ordinals, purged_ordinals);
+        state->purged_ordinals.insert(state->purged_ordinals.end(), purged_ordinals.begin(), purged_ordinals.end());
+        state->is_merging = false;
+        state->changed.notify_all();
+    }
+}
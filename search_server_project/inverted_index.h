@@ -0,0 +1,225 @@
+#pragma once
+
+#include "segment.h"
+#include "term_pool.h"
+
+#include <atomic>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Buffered postings of one term: document ordinals in ascending order and their term
+// counts stored in two contiguous arrays
+class PostingList {
+public:
+    void Add(int ordinal, int term_count);
+
+    // Removes all postings whose ordinal satisfies the predicate in one pass
+    template <typename OrdinalPredicate>
+    void RemoveIf(OrdinalPredicate predicate);
+
+    bool Contains(int ordinal) const;
+
+    size_t size() const;
+
+    bool empty() const;
+
+    PostingRun GetRun() const {
+        PostingRun run;
+        run.ordinals = ordinals_.data();
+        run.term_counts = term_counts_.data();
+        run.size = ordinals_.size();
+        return run;
+    }
+
+private:
+    std::vector<int> ordinals_;
+    std::vector<uint32_t> term_counts_;
+};
+
+// New postings go to a small mutable buffer, which is frozen into an immutable compressed
+// segment once it holds the buffer limit. A background merger combines segments of similar size:
+// MERGE_FACTOR segments of one tier become a segment of the next tier, and postings of
+// removed documents are purged on the way.
+// Writers must not run concurrently with other methods; queries are safe against the merger.
+class InvertedIndex {
+public:
+    static constexpr size_t DEFAULT_BUFFER_LIMIT = 1 << 16;
+    static constexpr size_t MERGE_FACTOR = 4;
+
+    InvertedIndex();
+
+    InvertedIndex(const InvertedIndex& other);
+
+    InvertedIndex(InvertedIndex&& other) = default;
+
+    InvertedIndex& operator=(const InvertedIndex&) = delete;
+
+    ~InvertedIndex();
+
+    // Returns the id of the term
+    int AddPosting(std::string_view term, int ordinal, int term_count);
+
+    // Postings of ordinals and term counts must be sorted by ordinal; returns the id of the term
+    int AddPostings(std::string_view term, const std::vector<std::pair<int, int>>& postings);
+
+    // Freezes the buffer into a segment if it is full. Call between documents only:
+    // all postings of a document must stay either in the buffer or in one segment.
+    void FlushBufferIfFull();
+
+    // Number of postings the buffer takes before it is frozen
+    void SetBufferLimit(size_t posting_count);
+
+    // Buffers of distinct terms may be purged concurrently. Postings in segments are
+    // left to the merger.
+    template <typename OrdinalPredicate>
+    void RemoveBufferedPostingsIf(int term_id, OrdinalPredicate predicate) {
+        buffer_[term_id].RemoveIf(predicate);
+    }
+
+    // Accounts for a removed document with the given terms. Returns true if the document
+    // has no postings in segments, so its ordinal may be reused once its buffered postings
+    // are purged. Otherwise the ordinal is returned by TakePurgedOrdinals after a merge.
+    bool RetireDocument(int ordinal, const std::vector<std::pair<int, double>>& document_terms);
+
+    // Ordinals of removed documents whose postings were purged since the last call
+    std::vector<int> TakePurgedOrdinals();
+
+    // Gives the id back to the dictionary once no posting of the term is left
+    void ReleaseTermIfUnused(int term_id);
+
+    // Returns -1 if the term is not indexed
+    int FindTermId(std::string_view term) const;
+
+    // Number of documents with the term, not counting removed ones
+    int GetDocumentFreq(int term_id) const {
+        return document_freqs_[term_id];
+    }
+
+    // Safe to call from concurrent const queries
+    double GetInverseDocumentFreq(int term_id, int document_count) const;
+
+    // Term frequencies of the term's documents are term_count * inverse_word_count; the index keeps
+    // the largest of both, which bound the relevance the term adds to any document. The bounds
+    // are not lowered when documents are removed, only when the term is no longer indexed.
+    void RaiseTermFreqBound(int term_id, int term_count, double inverse_word_count);
+
+    double GetMaxTermFreq(int term_id) const {
+        return term_freq_bounds_[term_id].max_term_freq;
+    }
+
+    double GetMaxInverseWordCount(int term_id) const {
+        return term_freq_bounds_[term_id].max_inverse_word_count;
+    }
+
+    // The list stays valid while the pointer is held, whatever the merger does
+    std::shared_ptr<const SegmentList> GetSegments() const;
+
+    // Calls visitor with every run of postings of the term: the buffered one and one per
+    // segment. Runs in segments may hold postings of removed documents.
+    template <typename Visitor>
+    void ForEachPostingRun(int term_id, const SegmentList& segments, Visitor visitor) const;
+
+    // The view stays valid until Compact
+    std::string_view GetTerm(int term_id) const {
+        return terms_.GetTerm(term_id);
+    }
+
+    size_t GetTermCount() const;
+
+    // Term ids are below it, including those of released terms
+    int GetTermIdCount() const {
+        return static_cast<int>(document_freqs_.size());
+    }
+
+    size_t GetSegmentCount() const;
+
+    // Bytes held by buffered and compressed postings
+    size_t GetPostingByteCount() const;
+
+    // Merges the buffer and all segments into one segment, then releases terms left
+    // without postings and reclaims their bytes
+    void Compact();
+
+    void WriteSnapshot(SnapshotWriter& writer) const;
+
+    // Terms and postings are borrowed from the reader's buffer, which must outlive the index.
+    // Postings must have ordinals below ordinal_count.
+    void ReadSnapshot(SnapshotReader& reader, int ordinal_count);
+
+private:
+    struct MergeState;
+
+    // Concurrent queries of one document count all store the same value, so the value
+    // needs no lock: it is published by storing its document count after it
+    struct CachedInverseDocumentFreq {
+        CachedInverseDocumentFreq() = default;
+
+        CachedInverseDocumentFreq(const CachedInverseDocumentFreq& other);
+
+        CachedInverseDocumentFreq& operator=(const CachedInverseDocumentFreq& other);
+
+        std::atomic<double> value{0.0};
+        std::atomic<int> document_count{-1};
+    };
+
+    struct TermFreqBound {
+        double max_term_freq = 0.0;
+        double max_inverse_word_count = 0.0;
+    };
+
+    TermPool terms_;
+    std::vector<int> document_freqs_;
+    std::vector<TermFreqBound> term_freq_bounds_;
+    mutable std::vector<CachedInverseDocumentFreq> inverse_document_freqs_;
+    std::vector<PostingList> buffer_;
+    // Terms with buffered postings, may repeat
+    std::vector<int> buffer_term_ids_;
+    size_t buffer_posting_count_ = 0;
+    size_t buffer_limit_ = DEFAULT_BUFFER_LIMIT;
+    std::shared_ptr<MergeState> merge_state_;
+    std::thread merger_;
+
+    int InternTerm(std::string_view term);
+
+    void AddDocumentFreq(int term_id, int delta);
+
+    // Returns nullptr if the buffer is empty
+    std::shared_ptr<const Segment> FreezeBuffer() const;
+
+    void ClearBuffer();
+
+    static void RunMerger(std::shared_ptr<MergeState> state);
+};
+
+template <typename OrdinalPredicate>
+void PostingList::RemoveIf(OrdinalPredicate predicate) {
+    size_t kept = 0;
+    for (size_t i = 0; i < ordinals_.size(); ++i) {
+        if (!predicate(ordinals_[i])) {
+            ordinals_[kept] = ordinals_[i];
+            term_counts_[kept] = term_counts_[i];
+            ++kept;
+        }
+    }
+    ordinals_.resize(kept);
+    term_counts_.resize(kept);
+}
+
+template <typename Visitor>
+void InvertedIndex::ForEachPostingRun(int term_id, const SegmentList& segments, Visitor visitor) const {
+    if (!buffer_[term_id].empty()) {
+        visitor(buffer_[term_id].GetRun());
+    }
+    for (const auto& segment : segments) {
+        const PostingRun run = segment->FindPostings(term_id);
+        if (!run.empty()) {
+            visitor(run);
+        }
+    }
+}
@@ -0,0 +1,325 @@
+#include "json_lines_reader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+class JsonLineParser {
+public:
+    explicit JsonLineParser(string_view line)
+        : line_(line) {
+    }
+
+    void ParseDocument(RawDocument& document) {
+        Expect('{');
+        if (!Consume('}')) {
+            do {
+                const string key = ParseString();
+                Expect(':');
+                if (key == "id"sv) {
+                    document.id = ParseInt();
+                } else if (key == "text"sv) {
+                    document.text = ParseString();
+                } else if (key == "status"sv) {
+                    document.status = ParseStatus();
+                } else if (key == "ratings"sv) {
+                    document.ratings.clear();
+                    Expect('[');
+                    if (!Consume(']')) {
+                        do {
+                            document.ratings.push_back(ParseInt());
+                        } while (Consume(','));
+                        Expect(']');
+                    }
+                } else {
+                    SkipValue();
+                }
+            } while (Consume(','));
+            Expect('}');
+        }
+        SkipSpaces();
+        if (pos_ != line_.size()) {
+            Fail("trailing characters"sv);
+        }
+    }
+
+private:
+    [[noreturn]] void Fail(string_view reason) const {
+        throw invalid_argument("Invalid JSON document ("s + string(reason) + " at column "s + to_string(pos_ + 1) + ")"s);
+    }
+
+    void SkipSpaces() {
+        while (pos_ < line_.size() && (line_[pos_] == ' ' || line_[pos_] == '\t' || line_[pos_] == '\r')) {
+            ++pos_;
+        }
+    }
+
+    char Peek() {
+        SkipSpaces();
+        if (pos_ == line_.size()) {
+            Fail("unexpected end of line"sv);
+        }
+        return line_[pos_];
+    }
+
+    bool Consume(char c) {
+        if (Peek() != c) {
+            return false;
+        }
+        ++pos_;
+        return true;
+    }
+
+    void Expect(char c) {
+        if (!Consume(c)) {
+            Fail("expected '"s + c + "'"s);
+        }
+    }
+
+    int ParseInt() {
+        SkipSpaces();
+        const size_t start = pos_;
+        if (pos_ < line_.size() && line_[pos_] == '-') {
+            ++pos_;
+        }
+        long long value = 0;
+        const size_t digits_start = pos_;
+        for (; pos_ < line_.size() && line_[pos_] >= '0' && line_[pos_] <= '9'; ++pos_) {
+            value = value * 10 + (line_[pos_] - '0');
+            if (value > 1LL << 31) {
+                Fail("number out of range"sv);
+            }
+        }
+        if (pos_ == digits_start) {
+            Fail("expected a number"sv);
+        }
+        if (line_[start] == '-') {
+            value = -value;
+        }
+        if (value > numeric_limits<int>::max()) {
+            Fail("number out of range"sv);
+        }
+        return static_cast<int>(value);
+    }
+
+    DocumentStatus ParseStatus() {
+        if (Peek() != '"') {
+            const int status = ParseInt();
+            if (status < static_cast<int>(DocumentStatus::ACTUAL) || status > static_cast<int>(DocumentStatus::REMOVED)) {
+                Fail("unknown status"sv);
+            }
+            return static_cast<DocumentStatus>(status);
+        }
+        const string name = ParseString();
+        if (name == "ACTUAL"sv) {
+            return DocumentStatus::ACTUAL;
+        }
+        if (name == "IRRELEVANT"sv) {
+            return DocumentStatus::IRRELEVANT;
+        }
+        if (name == "BANNED"sv) {
+            return DocumentStatus::BANNED;
+        }
+        if (name == "REMOVED"sv) {
+            return DocumentStatus::REMOVED;
+        }
+        Fail("unknown status"sv);
+    }
+
+    string ParseString() {
+        Expect('"');
+        string result;
+        while (true) {
+            // Copy runs of plain characters at once
+            const size_t run_end = line_.find_first_of("\"\\"sv, pos_);
+            if (run_end == string_view::npos) {
+                pos_ = line_.size();
+                Fail("unterminated string"sv);
+            }
+            result.append(line_.substr(pos_, run_end - pos_));
+            pos_ = run_end + 1;
+            if (line_[run_end] == '"') {
+                return result;
+            }
+            if (pos_ == line_.size()) {
+                Fail("unterminated string"sv);
+            }
+            const char escaped = line_[pos_++];
+            switch (escaped) {
+                case '"': case '\\': case '/': result.push_back(escaped); break;
+                case 'b': result.push_back('\b'); break;
+                case 'f': result.push_back('\f'); break;
+                case 'n': result.push_back('\n'); break;
+                case 'r': result.push_back('\r'); break;
+                case 't': result.push_back('\t'); break;
+                case 'u': AppendCodePoint(result, ParseCodePoint()); break;
+                default: Fail("invalid escape"sv);
+            }
+        }
+    }
+
+    uint32_t ParseHex4() {
+        if (line_.size() - pos_ < 4) {
+            Fail("invalid escape"sv);
+        }
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i, ++pos_) {
+            const char c = line_[pos_];
+            value <<= 4;
+            if (c >= '0' && c <= '9') {
+                value |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                value |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                value |= c - 'A' + 10;
+            } else {
+                Fail("invalid escape"sv);
+            }
+        }
+        return value;
+    }
+
+    uint32_t ParseCodePoint() {
+        const uint32_t code_point = ParseHex4();
+        if (code_point < 0xD800 || code_point > 0xDBFF) {
+            return code_point;
+        }
+        if (line_.substr(pos_, 2) != "\\u"sv) {
+            Fail("unpaired surrogate"sv);
+        }
+        pos_ += 2;
+        const uint32_t low = ParseHex4();
+        if (low < 0xDC00 || low > 0xDFFF) {
+            Fail("unpaired surrogate"sv);
+        }
+        return 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+    }
+
+    static void AppendCodePoint(string& text, uint32_t code_point) {
+        if (code_point < 0x80) {
+            text.push_back(static_cast<char>(code_point));
+        } else if (code_point < 0x800) {
+            text.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+            text.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        } else if (code_point < 0x10000) {
+            text.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+            text.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+            text.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        } else {
+            text.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+            text.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+            text.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+            text.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        }
+    }
+
+    void SkipValue() {
+        const char c = Peek();
+        if (c == '"') {
+            ParseString();
+        } else if (c == '{' || c == '[') {
+            const char closing = c == '{' ? '}' : ']';
+            ++pos_;
+            if (Consume(closing)) {
+                return;
+            }
+            do {
+                if (c == '{') {
+                    ParseString();
+                    Expect(':');
+                }
+                SkipValue();
+            } while (Consume(','));
+            Expect(closing);
+        } else {
+            // Numbers, true, false and null
+            const size_t start = pos_;
+            while (pos_ < line_.size() && line_[pos_] != ',' && line_[pos_] != '}' && line_[pos_] != ']'
+                   && line_[pos_] != ' ' && line_[pos_] != '\t') {
+                ++pos_;
+            }
+            if (pos_ == start) {
+                Fail("expected a value"sv);
+            }
+        }
+    }
+
+    string_view line_;
+    size_t pos_ = 0;
+};
+
+bool IsBlank(string_view line) {
+    return all_of(line.begin(), line.end(), [](char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    });
+}
+
+}  // namespace
+
+JsonLinesReader::JsonLinesReader(istream& input, size_t chunk_size)
+    : input_(input)
+    , buffer_(max<size_t>(chunk_size, 1)) {
+}
+
+bool JsonLinesReader::Read(RawDocument& document) {
+    string_view line;
+    do {
+        if (!NextLine(line)) {
+            return false;
+        }
+    } while (IsBlank(line));
+    document = RawDocument();
+    try {
+        JsonLineParser(line).ParseDocument(document);
+    } catch (const invalid_argument& e) {
+        throw invalid_argument("Line "s + to_string(line_number_) + ": "s + e.what());
+    }
+    return true;
+}
+
+size_t JsonLinesReader::GetByteCount() const {
+    return byte_count_;
+}
+
+bool JsonLinesReader::NextLine(string_view& line) {
+    size_t scan_from = begin_;
+    while (true) {
+        const char* line_end = static_cast<const char*>(memchr(buffer_.data() + scan_from, '\n', end_ - scan_from));
+        if (line_end != nullptr) {
+            const size_t length = line_end - (buffer_.data() + begin_);
+            line = string_view(buffer_.data() + begin_, length);
+            begin_ += length + 1;
+            byte_count_ += length + 1;
+            ++line_number_;
+            return true;
+        }
+        if (!input_) {
+            if (begin_ == end_) {
+                return false;
+            }
+            // The last line has no line break
+            line = string_view(buffer_.data() + begin_, end_ - begin_);
+            byte_count_ += end_ - begin_;
+            begin_ = end_;
+            ++line_number_;
+            return true;
+        }
+        // Keep the incomplete line and refill the rest of the buffer; a line longer
+        // than the buffer doubles it
+        memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+        if (end_ == buffer_.size()) {
+            buffer_.resize(2 * buffer_.size());
+        }
+        scan_from = end_;
+        input_.read(buffer_.data() + end_, static_cast<streamsize>(buffer_.size() - end_));
+        end_ += static_cast<size_t>(input_.gcount());
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "document.h"
+
+#include <istream>
+#include <string_view>
+#include <vector>
+
+// Reads one document per line from a JSON-lines stream, e.g.
+// {"id": 1, "text": "white cat", "status": "ACTUAL", "ratings": [8, -3]}
+// The input is pulled in large chunks and every line is parsed in place straight into
+// RawDocument fields, without building a tree of JSON values. Status is a DocumentStatus
+// name or number; missing fields keep their defaults and unknown fields are skipped.
+class JsonLinesReader {
+public:
+    explicit JsonLinesReader(std::istream& input, size_t chunk_size = 1 << 20);
+
+    // Returns false at the end of the input.
+    // Throws std::invalid_argument with the line number if a line is not a valid document.
+    bool Read(RawDocument& document);
+
+    // Bytes consumed so far, including line breaks
+    size_t GetByteCount() const;
+
+private:
+    // Returns false at the end of the input
+    bool NextLine(std::string_view& line);
+
+    std::istream& input_;
+    std::vector<char> buffer_;
+    size_t begin_ = 0;
+    size_t end_ = 0;
+    size_t byte_count_ = 0;
+    size_t line_number_ = 0;
+};
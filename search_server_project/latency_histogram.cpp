@@ -0,0 +1,69 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+
+using namespace std;
+
+LatencyHistogram::LatencyHistogram(Clock::duration window, size_t slice_count)
+    : slice_length_(max<Clock::duration>(Clock::duration(1), window / static_cast<int64_t>(max<size_t>(1, slice_count))))
+    , slices_(max<size_t>(1, slice_count)) {
+}
+
+void LatencyHistogram::Record(chrono::nanoseconds latency, Clock::time_point now) {
+    const int64_t index = GetSliceIndex(now);
+    const size_t bucket = GetLogLinearBucket<SUB_BUCKET_BITS>(static_cast<uint64_t>(max<int64_t>(0, latency.count())));
+    lock_guard<mutex> guard(mutex_);
+    Slice& slice = slices_[index % slices_.size()];
+    if (slice.index != index) {
+        slice.index = index;
+        slice.count = 0;
+        slice.counts.fill(0);
+    }
+    ++slice.count;
+    ++slice.counts[bucket];
+}
+
+chrono::nanoseconds LatencyHistogram::GetPercentile(double percentile, Clock::time_point now) const {
+    uint64_t count = 0;
+    const auto counts = SumSlices(now, count);
+    if (count == 0) {
+        return {};
+    }
+    // The same rank a sorted array of all latencies would be indexed with
+    const uint64_t rank = min(count - 1, static_cast<uint64_t>(max(0.0, percentile) * count));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        seen += counts[bucket];
+        if (seen > rank) {
+            return chrono::nanoseconds(GetLogLinearBucketLimit<SUB_BUCKET_BITS>(bucket));
+        }
+    }
+    return chrono::nanoseconds(GetLogLinearBucketLimit<SUB_BUCKET_BITS>(BUCKET_COUNT - 1));
+}
+
+size_t LatencyHistogram::GetCount(Clock::time_point now) const {
+    uint64_t count = 0;
+    SumSlices(now, count);
+    return count;
+}
+
+int64_t LatencyHistogram::GetSliceIndex(Clock::time_point time) const {
+    return time.time_since_epoch() / slice_length_;
+}
+
+array<uint64_t, LatencyHistogram::BUCKET_COUNT> LatencyHistogram::SumSlices(Clock::time_point now, uint64_t& count) const {
+    const int64_t last_index = GetSliceIndex(now);
+    const int64_t first_index = last_index - static_cast<int64_t>(slices_.size()) + 1;
+    array<uint64_t, BUCKET_COUNT> counts{};
+    lock_guard<mutex> guard(mutex_);
+    for (const Slice& slice : slices_) {
+        if (slice.index < first_index || slice.index > last_index || slice.count == 0) {
+            continue;
+        }
+        count += slice.count;
+        for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+            counts[bucket] += slice.counts[bucket];
+        }
+    }
+    return counts;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "log_linear_buckets.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Latencies recorded within the last window. The window is split into slices of equal length, and
+// the oldest slice is dropped once a new one starts. Buckets are log-linear, 16 per power of two,
+// so a percentile is reported less than 1/16 above the true one. Safe to use from many threads.
+class LatencyHistogram {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit LatencyHistogram(Clock::duration window = std::chrono::seconds(60), size_t slice_count = 6);
+
+    void Record(std::chrono::nanoseconds latency, Clock::time_point now = Clock::now());
+
+    // percentile is a fraction, e.g. 0.99. Zero if nothing was recorded within the window.
+    std::chrono::nanoseconds GetPercentile(double percentile, Clock::time_point now = Clock::now()) const;
+
+    size_t GetCount(Clock::time_point now = Clock::now()) const;
+
+private:
+    static constexpr size_t SUB_BUCKET_BITS = 4;
+    static constexpr size_t BUCKET_COUNT = LOG_LINEAR_BUCKET_COUNT<SUB_BUCKET_BITS>;
+
+    struct Slice {
+        int64_t index = -1;
+        uint64_t count = 0;
+        std::array<uint64_t, BUCKET_COUNT> counts{};
+    };
+
+    mutable std::mutex mutex_;
+    Clock::duration slice_length_;
+    std::vector<Slice> slices_;
+
+    int64_t GetSliceIndex(Clock::time_point time) const;
+
+    // Counts of the slices within the window ending at now
+    std::array<uint64_t, BUCKET_COUNT> SumSlices(Clock::time_point now, uint64_t& count) const;
+};
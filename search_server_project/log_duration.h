@@ -8,6 +8,7 @@
 #define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
 #define LOG_DURATION(x) LogDuration UNIQUE_VAR_NAME_PROFILE(x)
 
+// Prints the duration of one scope; hot paths are timed by PROBE_SCOPE from instrumentation.h
 class LogDuration {
 public:
     // заменим имя типа std::chrono::steady_clock
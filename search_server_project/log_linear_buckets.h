@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Histogram buckets of 64-bit values: values below 2^SubBucketBits get a bucket each, larger
+// ones 2^SubBucketBits buckets per power of two, so a bucket spans less than 2^-SubBucketBits
+// of its values.
+template <size_t SubBucketBits>
+constexpr size_t LOG_LINEAR_BUCKET_COUNT = (64 - SubBucketBits + 1) << SubBucketBits;
+
+template <size_t SubBucketBits>
+size_t GetLogLinearBucket(uint64_t value) {
+    if (value < (uint64_t{1} << SubBucketBits)) {
+        return static_cast<size_t>(value);
+    }
+    // The highest bit picks the power of two, the next SubBucketBits bits the bucket within it
+    const size_t exponent = 63 - __builtin_clzll(value);
+    const size_t shift = exponent - SubBucketBits;
+    const size_t sub_bucket = (value >> shift) & ((size_t{1} << SubBucketBits) - 1);
+    return ((shift + 1) << SubBucketBits) + sub_bucket;
+}
+
+// Largest value which falls into the bucket
+template <size_t SubBucketBits>
+uint64_t GetLogLinearBucketLimit(size_t bucket) {
+    if (bucket < (size_t{1} << SubBucketBits)) {
+        return bucket;
+    }
+    const size_t shift = (bucket >> SubBucketBits) - 1;
+    const uint64_t sub_bucket = bucket & ((size_t{1} << SubBucketBits) - 1);
+    const uint64_t first = ((uint64_t{1} << SubBucketBits) + sub_bucket) << shift;
+    return first + ((uint64_t{1} << shift) - 1);
+}
@@ -1,98 +1,75 @@
 ﻿#include "search_server.h"
 
-#include "log_duration.h"
+#include "ingest_documents.h"
+#include "instrumentation.h"
+#include "remove_duplicates.h"
 
-#include <execution>
+#include <fstream>
 #include <iostream>
-#include <random>
 #include <string>
 #include <vector>
 
 using namespace std;
 
-string GenerateWord(mt19937& generator, int max_length) {
-    const int length = uniform_int_distribution(1, max_length)(generator);
-    string word;
-    word.reserve(length);
-    for (int i = 0; i < length; ++i) {
-        word.push_back(uniform_int_distribution(static_cast<int>('a'), static_cast<int>('z'))(generator));
-    }
-    return word;
+void PrintDocument(const Document& document) {
+    cout << "{ document_id = "s << document.id << ", relevance = "s << document.relevance << ", rating = "s << document.rating << " }"s << endl;
 }
 
-vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
-    vector<string> words;
-    words.reserve(word_count);
-    for (int i = 0; i < word_count; ++i) {
-        words.push_back(GenerateWord(generator, max_length));
-    }
-    words.erase(unique(words.begin(), words.end()), words.end());
-    return words;
-}
+// A few documents searched, matched and deduplicated; timings live in search_server_benchmark
+void RunDemo() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    search_server.AddDocument(3, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    search_server.AddDocument(4, "big cat nasty hair"s, DocumentStatus::ACTUAL, {1, 2, 8});
+    search_server.AddDocument(5, "big dog cat vladislav"s, DocumentStatus::BANNED, {1, 3, 2});
 
-string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob = 0) {
-    string query;
-    for (int i = 0; i < word_count; ++i) {
-        if (!query.empty()) {
-            query.push_back(' ');
-        }
-        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
-            query.push_back('-');
+    for (const string& query : {"curly nasty cat"s, "curly nasty -pet"s}) {
+        cout << "Search for: "s << query << endl;
+        for (const Document& document : search_server.FindTopDocuments(query)) {
+            PrintDocument(document);
         }
-        query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
     }
-    return query;
-}
+    cout << "BANNED documents for: big cat"s << endl;
+    for (const Document& document : search_server.FindTopDocuments("big cat"s, DocumentStatus::BANNED)) {
+        PrintDocument(document);
+    }
 
-vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
-    vector<string> queries;
-    queries.reserve(query_count);
-    for (int i = 0; i < query_count; ++i) {
-        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
+    const auto [words, status] = search_server.MatchDocument("funny curly cat"s, 2);
+    cout << "Words of document 2 matching: funny curly cat:"s;
+    for (const string_view word : words) {
+        cout << ' ' << word;
     }
-    return queries;
-}
+    cout << endl;
 
-template <typename ExecutionPolicy>
-void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
-    LOG_DURATION(mark);
-    double total_relevance = 0;
-    for (const string_view query : queries) {
-        for (const auto& document : search_server.FindTopDocuments(policy, query)) {
-            total_relevance += document.relevance;
-        }
+    for (const int document_id : RemoveDuplicates(search_server)) {
+        cout << "Found duplicate document id "s << document_id << endl;
     }
-    cout << total_relevance << endl;
+    cout << "Documents left: "s << search_server.GetDocumentCount() << endl;
 }
 
-template <typename ExecutionPolicy>
-void TestMatch(string_view mark, SearchServer search_server, const string& query, ExecutionPolicy&& policy) {
-    LOG_DURATION(mark);
-    const int document_count = search_server.GetDocumentCount();
-    int word_count = 0;
-    for (int id = 0; id < document_count; ++id) {
-        const auto [words, status] = search_server.MatchDocument(policy, query, id);
-        word_count += words.size();
+// With an argument, indexes a JSON-lines file ("-" for stdin) and reports the throughput
+int IngestFile(const string& path) {
+    SearchServer search_server;
+    if (path == "-"s) {
+        cout << IngestDocuments(search_server, cin) << endl;
+        return 0;
+    }
+    ifstream input(path, ios::binary);
+    if (!input) {
+        cerr << "Cannot open "s << path << endl;
+        return 1;
     }
-    cout << word_count << endl;
+    cout << IngestDocuments(search_server, input) << endl;
+    return 0;
 }
 
-int main() {
-    mt19937 generator;
-
-    const auto dictionary = GenerateDictionary(generator, 1000, 10);
-    const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
-
-    SearchServer search_server(dictionary[0]);
-    for (size_t i = 0; i < documents.size(); ++i) {
-        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        return IngestFile(argv[1]);
     }
-
-    const auto queries = GenerateQueries(generator, dictionary, 100, 70);
-    const string query = GenerateQuery(generator, dictionary, 500, 0.1);
-    
-    Test("seq"s, search_server, queries, execution::seq);
-    Test("par"s, search_server, queries, execution::par);
-    TestMatch("seq"s, search_server, query, execution::seq);
-    TestMatch("par"s, search_server, query, execution::par);
-}
\ No newline at end of file
+    RunDemo();
+#ifdef SEARCH_SERVER_INSTRUMENTATION
+    DumpProbeStats(cerr);
+#endif
+}
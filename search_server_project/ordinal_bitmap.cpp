@@ -0,0 +1,93 @@
+#include "ordinal_bitmap.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+// Whether any bit in [first_bit, last_bit] of the words is set; last_bit must be within them
+bool AnyBitInRange(const vector<uint64_t>& words, size_t first_bit, size_t last_bit) {
+    const size_t first_word = first_bit / 64;
+    const size_t last_word = last_bit / 64;
+    const uint64_t first_mask = ~uint64_t{0} << (first_bit % 64);
+    const uint64_t last_mask = ~uint64_t{0} >> (63 - last_bit % 64);
+    if (first_word == last_word) {
+        return (words[first_word] & first_mask & last_mask) != 0;
+    }
+    if ((words[first_word] & first_mask) != 0 || (words[last_word] & last_mask) != 0) {
+        return true;
+    }
+    return any_of(words.begin() + first_word + 1, words.begin() + last_word, [](uint64_t word) {
+        return word != 0;
+    });
+}
+}
+
+void OrdinalBitmap::Set(int ordinal) {
+    const size_t word = static_cast<size_t>(ordinal) / 64;
+    if (word >= words_.size()) {
+        words_.resize(word + 1);
+        summary_.resize(word / 64 + 1);
+    }
+    words_[word] |= uint64_t{1} << (ordinal % 64);
+    summary_[word / 64] |= uint64_t{1} << (word % 64);
+}
+
+void OrdinalBitmap::Reset(int ordinal) {
+    const size_t word = static_cast<size_t>(ordinal) / 64;
+    if (word >= words_.size()) {
+        return;
+    }
+    words_[word] &= ~(uint64_t{1} << (ordinal % 64));
+    if (words_[word] == 0) {
+        summary_[word / 64] &= ~(uint64_t{1} << (word % 64));
+    }
+}
+
+int OrdinalBitmap::FindNext(int ordinal) const {
+    size_t word = static_cast<size_t>(ordinal) / 64;
+    if (word >= words_.size()) {
+        return -1;
+    }
+    const uint64_t bits = words_[word] & (~uint64_t{0} << (ordinal % 64));
+    if (bits != 0) {
+        return static_cast<int>(word * 64 + __builtin_ctzll(bits));
+    }
+    // The next non-empty word is found by the summary
+    ++word;
+    for (size_t summary_word = word / 64; summary_word < summary_.size(); ++summary_word) {
+        uint64_t summary_bits = summary_[summary_word];
+        if (summary_word == word / 64) {
+            summary_bits &= ~uint64_t{0} << (word % 64);
+        }
+        if (summary_bits != 0) {
+            const size_t next_word = summary_word * 64 + __builtin_ctzll(summary_bits);
+            return static_cast<int>(next_word * 64 + __builtin_ctzll(words_[next_word]));
+        }
+    }
+    return -1;
+}
+
+bool OrdinalBitmap::AnyInRange(int first_ordinal, int last_ordinal) const {
+    if (words_.empty() || first_ordinal > last_ordinal) {
+        return false;
+    }
+    const size_t first_bit = static_cast<size_t>(first_ordinal);
+    const size_t last_bit = min(static_cast<size_t>(last_ordinal), words_.size() * 64 - 1);
+    if (first_bit > last_bit) {
+        return false;
+    }
+    const size_t first_word = first_bit / 64;
+    const size_t last_word = last_bit / 64;
+    if (last_word - first_word < 2) {
+        return AnyBitInRange(words_, first_bit, last_bit);
+    }
+    // The partial words at the ends, then the whole words between them by their summary bits
+    return AnyBitInRange(words_, first_bit, first_word * 64 + 63) || AnyBitInRange(words_, last_word * 64, last_bit)
+           || AnyBitInRange(summary_, first_word + 1, last_word - 1);
+}
+
+void OrdinalBitmap::Clear() {
+    words_.clear();
+    summary_.clear();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Set of ordinals as a bitmap with a summary bit for every non-empty word, so a query over
+// a wide range of ordinals looks at one bit per 64 words where the set is empty.
+class OrdinalBitmap {
+public:
+    void Set(int ordinal);
+
+    void Reset(int ordinal);
+
+    bool Test(int ordinal) const {
+        const size_t word = static_cast<size_t>(ordinal) / 64;
+        return word < words_.size() && (words_[word] >> (ordinal % 64) & 1) != 0;
+    }
+
+    // First ordinal of the set not less than the given one, -1 if there is none
+    int FindNext(int ordinal) const;
+
+    // Whether any ordinal in [first_ordinal, last_ordinal] is in the set
+    bool AnyInRange(int first_ordinal, int last_ordinal) const;
+
+    void Clear();
+
+private:
+    std::vector<uint64_t> words_;
+    // Bit i is set if words_[i] is not zero
+    std::vector<uint64_t> summary_;
+};
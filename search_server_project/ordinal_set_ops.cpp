@@ -0,0 +1,160 @@
+#include "ordinal_set_ops.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ORDINAL_SET_OPS_X86
+#endif
+
+using namespace std;
+
+namespace {
+// Positions of elements found in b when is_intersection, of the others otherwise
+template <bool is_intersection>
+size_t MatchScalar(const int* a, size_t a_size, const int* b, size_t b_size, size_t i, size_t j, uint32_t* positions) {
+    size_t count = 0;
+    for (; i < a_size; ++i) {
+        while (j < b_size && b[j] < a[i]) {
+            ++j;
+        }
+        if ((j < b_size && b[j] == a[i]) == is_intersection) {
+            positions[count++] = static_cast<uint32_t>(i);
+        }
+    }
+    return count;
+}
+
+// Writes positions of the block lanes whose bit in the mask is set
+size_t EmitLanes(unsigned mask, size_t first, uint32_t* positions) {
+    size_t count = 0;
+    while (mask != 0) {
+        positions[count++] = static_cast<uint32_t>(first + __builtin_ctz(mask));
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+#ifdef ORDINAL_SET_OPS_X86
+// Compares every lane of an a block with every lane of a b block and keeps, per a lane,
+// whether it met an equal value. A block of a is finished once b's block reaches its maximum;
+// lanes of an unfinished block are passed on to the scalar tail through the mask.
+template <bool is_intersection>
+size_t MatchSse2(const int* a, size_t a_size, const int* b, size_t b_size, uint32_t* positions) {
+    size_t i = 0;
+    size_t j = 0;
+    size_t count = 0;
+    unsigned mask = 0;
+    while (i + 4 <= a_size && j + 4 <= b_size) {
+        const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+        __m128i equal = _mm_cmpeq_epi32(va, vb);
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1))));
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3))));
+        mask |= static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(equal)));
+        const int a_max = a[i + 3];
+        const int b_max = b[j + 3];
+        if (a_max <= b_max) {
+            count += EmitLanes(is_intersection ? mask : ~mask & 0xFu, i, positions + count);
+            i += 4;
+            mask = 0;
+        }
+        if (b_max <= a_max) {
+            j += 4;
+        }
+    }
+    for (; mask != 0 && i < a_size; ++i, mask >>= 1) {
+        if (mask & 1u) {
+            if (is_intersection) {
+                positions[count++] = static_cast<uint32_t>(i);
+            }
+            continue;
+        }
+        count += MatchScalar<is_intersection>(a, i + 1, b, b_size, i, j, positions + count);
+    }
+    return count + MatchScalar<is_intersection>(a, a_size, b, b_size, i, j, positions + count);
+}
+
+template <bool is_intersection>
+__attribute__((target("avx2")))
+size_t MatchAvx2(const int* a, size_t a_size, const int* b, size_t b_size, uint32_t* positions) {
+    size_t i = 0;
+    size_t j = 0;
+    size_t count = 0;
+    unsigned mask = 0;
+    const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+    while (i + 8 <= a_size && j + 8 <= b_size) {
+        const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+        __m256i equal = _mm256_cmpeq_epi32(va, vb);
+        for (int shift = 1; shift < 8; ++shift) {
+            vb = _mm256_permutevar8x32_epi32(vb, rotate);
+            equal = _mm256_or_si256(equal, _mm256_cmpeq_epi32(va, vb));
+        }
+        mask |= static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(equal)));
+        const int a_max = a[i + 7];
+        const int b_max = b[j + 7];
+        if (a_max <= b_max) {
+            count += EmitLanes(is_intersection ? mask : ~mask & 0xFFu, i, positions + count);
+            i += 8;
+            mask = 0;
+        }
+        if (b_max <= a_max) {
+            j += 8;
+        }
+    }
+    for (; mask != 0 && i < a_size; ++i, mask >>= 1) {
+        if (mask & 1u) {
+            if (is_intersection) {
+                positions[count++] = static_cast<uint32_t>(i);
+            }
+            continue;
+        }
+        count += MatchScalar<is_intersection>(a, i + 1, b, b_size, i, j, positions + count);
+    }
+    return count + MatchScalar<is_intersection>(a, a_size, b, b_size, i, j, positions + count);
+}
+#endif
+
+template <bool is_intersection>
+size_t Match(const int* a, size_t a_size, const int* b, size_t b_size, uint32_t* positions, OrdinalKernel kernel) {
+#ifdef ORDINAL_SET_OPS_X86
+    if (kernel == OrdinalKernel::AVX2) {
+        return MatchAvx2<is_intersection>(a, a_size, b, b_size, positions);
+    }
+    if (kernel == OrdinalKernel::SSE2) {
+        return MatchSse2<is_intersection>(a, a_size, b, b_size, positions);
+    }
+#endif
+    return MatchScalar<is_intersection>(a, a_size, b, b_size, 0, 0, positions);
+}
+}
+
+OrdinalKernel GetOrdinalKernel() {
+    static const OrdinalKernel kernel = IsOrdinalKernelSupported(OrdinalKernel::AVX2) ? OrdinalKernel::AVX2
+                                      : IsOrdinalKernelSupported(OrdinalKernel::SSE2) ? OrdinalKernel::SSE2
+                                      : OrdinalKernel::SCALAR;
+    return kernel;
+}
+
+bool IsOrdinalKernelSupported(OrdinalKernel kernel) {
+    switch (kernel) {
+#ifdef ORDINAL_SET_OPS_X86
+    case OrdinalKernel::AVX2:
+        return __builtin_cpu_supports("avx2");
+    case OrdinalKernel::SSE2:
+        return __builtin_cpu_supports("sse2");
+#endif
+    case OrdinalKernel::SCALAR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+size_t IntersectOrdinals(const int* a, size_t a_size, const int* b, size_t b_size, uint32_t* positions, OrdinalKernel kernel) {
+    return Match<true>(a, a_size, b, b_size, positions, kernel);
+}
+
+size_t SubtractOrdinals(const int* a, size_t a_size, const int* b, size_t b_size, uint32_t* positions, OrdinalKernel kernel) {
+    return Match<false>(a, a_size, b, b_size, positions, kernel);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Set operations over sorted arrays of distinct ordinals. They return positions in the
+// first array rather than values, so the caller can pick term frequencies stored next to it.
+// x86 processors compare blocks of ordinals with SSE2 or, when available, AVX2.
+enum class OrdinalKernel {
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+// Fastest kernel the processor supports
+OrdinalKernel GetOrdinalKernel();
+
+bool IsOrdinalKernelSupported(OrdinalKernel kernel);
+
+// Writes positions of a's elements which are also in b, returns their number.
+// positions must hold a_size elements.
+size_t IntersectOrdinals(const int* a, size_t a_size, const int* b, size_t b_size, uint32_t* positions,
+                         OrdinalKernel kernel = GetOrdinalKernel());
+
+// Writes positions of a's elements which are not in b, returns their number.
+// positions must hold a_size elements.
+size_t SubtractOrdinals(const int* a, size_t a_size, const int* b, size_t b_size, uint32_t* positions,
+                        OrdinalKernel kernel = GetOrdinalKernel());
@@ -0,0 +1,87 @@
+#include "posting_cursor.h"
+
+#include <algorithm>
+
+using namespace std;
+
+PostingCursor::PostingCursor(const PostingRun& run, int first_ordinal, int last_ordinal)
+    : run_(run)
+    , last_ordinal_(last_ordinal) {
+    if (run_.segment == nullptr) {
+        size_ = lower_bound(run_.ordinals, run_.ordinals + run_.size, last_ordinal) - run_.ordinals;
+        position_ = lower_bound(run_.ordinals, run_.ordinals + size_, first_ordinal) - run_.ordinals;
+        ordinal_ = position_ < size_ ? run_.ordinals[position_] : END;
+        return;
+    }
+    DecodeBlock(FindBlock(run_.first_block, first_ordinal));
+    if (ordinal_ != END) {
+        ordinal_ = first_ordinal - 1;
+        SeekTo(first_ordinal);
+    }
+}
+
+void PostingCursor::SeekTo(int ordinal) {
+    if (ordinal <= ordinal_) {
+        return;
+    }
+    if (run_.segment == nullptr) {
+        position_ = lower_bound(run_.ordinals + position_, run_.ordinals + size_, ordinal) - run_.ordinals;
+        ordinal_ = position_ < size_ ? run_.ordinals[position_] : END;
+        return;
+    }
+    if (run_.segment->GetBlock(block_).last_ordinal < ordinal) {
+        DecodeBlock(FindBlock(max(block_ + 1, shallow_block_), ordinal));
+        if (ordinal_ == END) {
+            return;
+        }
+    }
+    position_ = lower_bound(block_ordinals_ + position_, block_ordinals_ + size_, ordinal) - block_ordinals_;
+    ordinal_ = block_ordinals_[position_];
+    if (ordinal_ >= last_ordinal_) {
+        ordinal_ = END;
+    }
+}
+
+uint32_t PostingCursor::GetMaxTermCount(int ordinal) {
+    if (ordinal_ == END) {
+        return 0;
+    }
+    if (run_.segment == nullptr) {
+        return UINT32_MAX;
+    }
+    if (ordinal > run_.segment->GetBlock(block_).last_ordinal) {
+        shallow_block_ = FindBlock(max(block_ + 1, shallow_block_), ordinal);
+        if (shallow_block_ == run_.last_block || run_.segment->GetBlock(shallow_block_).first_ordinal >= last_ordinal_) {
+            return 0;
+        }
+        const uint8_t max_term_count = run_.segment->GetBlock(shallow_block_).max_term_count;
+        return max_term_count == MAX_BLOCK_TERM_COUNT ? UINT32_MAX : max_term_count;
+    }
+    const uint8_t max_term_count = run_.segment->GetBlock(block_).max_term_count;
+    return max_term_count == MAX_BLOCK_TERM_COUNT ? UINT32_MAX : max_term_count;
+}
+
+size_t PostingCursor::FindBlock(size_t block, int ordinal) const {
+    size_t high = run_.last_block;
+    while (block < high) {
+        const size_t middle = (block + high) / 2;
+        if (run_.segment->GetBlock(middle).last_ordinal < ordinal) {
+            block = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return block;
+}
+
+void PostingCursor::DecodeBlock(size_t block) {
+    if (run_.segment == nullptr || block == run_.last_block) {
+        ordinal_ = END;
+        return;
+    }
+    block_ = block;
+    shallow_block_ = max(shallow_block_, block);
+    size_ = run_.segment->DecodeBlock(block, block_ordinals_, block_term_counts_);
+    position_ = 0;
+    ordinal_ = block_ordinals_[0] < last_ordinal_ ? block_ordinals_[0] : END;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "segment.h"
+
+#include <climits>
+#include <cstdint>
+
+// Walks the postings of a run with ordinals in [first_ordinal, last_ordinal) in ascending order.
+// Compressed blocks are decoded only when the cursor steps into them; their skip data answers
+// shallow questions about a block without decoding it.
+class PostingCursor {
+public:
+    // Ordinal of a cursor past its last posting
+    static constexpr int END = INT_MAX;
+
+    PostingCursor(const PostingRun& run, int first_ordinal, int last_ordinal);
+
+    int GetOrdinal() const {
+        return ordinal_;
+    }
+
+    uint32_t GetTermCount() const {
+        return run_.segment == nullptr ? run_.term_counts[position_] : block_term_counts_[position_];
+    }
+
+    void Next() {
+        ++position_;
+        if (position_ == size_) {
+            DecodeBlock(block_ + 1);
+        } else {
+            ordinal_ = run_.segment == nullptr ? run_.ordinals[position_] : block_ordinals_[position_];
+        }
+        if (ordinal_ >= last_ordinal_) {
+            ordinal_ = END;
+        }
+    }
+
+    // Moves to the first posting with an ordinal not less than the given one
+    void SeekTo(int ordinal);
+
+    // Upper bound of the term counts of postings from the given ordinal up to the end of its
+    // block, which is found by skip data only. 0 if no posting is left.
+    uint32_t GetMaxTermCount(int ordinal);
+
+private:
+    PostingRun run_;
+    int last_ordinal_;
+    int ordinal_ = END;
+    // Position in the run's arrays, or in the decoded block
+    size_t position_ = 0;
+    size_t size_ = 0;
+    size_t block_ = 0;
+    // Block found by GetMaxTermCount, never behind block_
+    size_t shallow_block_ = 0;
+    int block_ordinals_[POSTING_BLOCK_SIZE];
+    uint32_t block_term_counts_[POSTING_BLOCK_SIZE];
+
+    // First block not before the given one whose last ordinal is not less than the given ordinal
+    size_t FindBlock(size_t block, int ordinal) const;
+
+    void DecodeBlock(size_t block);
+};
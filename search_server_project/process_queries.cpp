@@ -2,38 +2,123 @@
 
 #include <vector>
 #include <string>
+#include <iterator>
 #include <numeric>
 #include <execution>
 
 #include "document.h"
 #include "search_server.h"
+#include "top_documents.h"
 
+using namespace std;
+
+namespace {
+// Queries without postings still cost parsing and a pass over the index
+const size_t QUERY_COST = 64;
+
+// Queries [first_query, last_query) scored whole, or one part of a single query
+struct QueryTask {
+    size_t first_query;
+    size_t last_query;
+    size_t part;
+    size_t part_count;
+};
+
+QueryExecutor& GetSharedExecutor() {
+    static QueryExecutor executor;
+    return executor;
+}
+}
+
+JoinedDocuments::JoinedDocuments(vector<vector<Document>> results)
+    : results_(move(results)) {
+    for (const auto& documents : results_) {
+        size_ += documents.size();
+    }
+}
+
+QueryExecutor::QueryExecutor(size_t thread_count, size_t min_task_cost)
+    : pool_(thread_count)
+    , min_task_cost_(max<size_t>(1, min_task_cost)) {
+}
+
+vector<vector<Document>> QueryExecutor::Process(const SearchServer& search_server, const vector<string>& queries) {
+    const size_t thread_count = pool_.GetThreadCount();
+    vector<SearchServer::CompiledQuery> compiled_queries(queries.size());
+    vector<size_t> costs(queries.size());
+    const size_t chunk_count = min(queries.size(), thread_count * TASKS_PER_THREAD);
+    pool_.Run(chunk_count, [&](size_t chunk) {
+        for (size_t i = queries.size() * chunk / chunk_count; i < queries.size() * (chunk + 1) / chunk_count; ++i) {
+            compiled_queries[i] = search_server.CompileQuery(queries[i]);
+            costs[i] = search_server.EstimateQueryCost(compiled_queries[i]) + QUERY_COST;
+        }
+    });
+
+    const size_t total_cost = accumulate(costs.begin(), costs.end(), size_t{0});
+    const size_t task_cost = max(min_task_cost_, total_cost / (thread_count * TASKS_PER_THREAD));
+    vector<QueryTask> tasks;
+    size_t batch_first = 0;
+    size_t batch_cost = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        if (costs[i] <= task_cost || thread_count == 1) {
+            batch_cost += costs[i];
+            if (batch_cost >= task_cost) {
+                tasks.push_back({batch_first, i + 1, 0, 1});
+                batch_first = i + 1;
+                batch_cost = 0;
+            }
+            continue;
+        }
+        if (batch_first < i) {
+            tasks.push_back({batch_first, i, 0, 1});
+        }
+        const size_t part_count = min(thread_count, (costs[i] + task_cost - 1) / task_cost);
+        for (size_t part = 0; part < part_count; ++part) {
+            tasks.push_back({i, i + 1, part, part_count});
+        }
+        batch_first = i + 1;
+        batch_cost = 0;
+    }
+    if (batch_first < queries.size()) {
+        tasks.push_back({batch_first, queries.size(), 0, 1});
+    }
+
+    vector<vector<Document>> results(queries.size());
+    // Parts of split queries are kept apart until all of them are done
+    vector<vector<Document>> part_results(tasks.size());
+    pool_.Run(tasks.size(), [&](size_t i) {
+        const QueryTask& task = tasks[i];
+        if (task.part_count > 1) {
+            part_results[i] = search_server.FindTopDocumentsPart(compiled_queries[task.first_query], DocumentStatus::ACTUAL,
+                                                                 task.part, task.part_count);
+            return;
+        }
+        for (size_t query = task.first_query; query < task.last_query; ++query) {
+            results[query] = search_server.FindTopDocuments(execution::seq, compiled_queries[query], DocumentStatus::ACTUAL);
+        }
+    });
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        const QueryTask& task = tasks[i];
+        if (task.part_count == 1) {
+            continue;
+        }
+        auto& documents = results[task.first_query];
+        documents.insert(documents.end(), part_results[i].begin(), part_results[i].end());
+        if (task.part + 1 == task.part_count) {
+            SelectTopDocuments(documents, MAX_RESULT_DOCUMENT_COUNT);
+        }
+    }
+    return results;
+}
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries){
-    std::vector<std::vector<Document>> result(queries.size());
-    transform_inclusive_scan( std::execution::par,
-        queries.begin(), queries.end(),
-        result.begin(),
-        [](std::vector<Document> lhs, std::vector<Document> rhs){
-            return rhs;
-        },
-        [&search_server](const std::string& query) {
-            return search_server.FindTopDocuments(std::execution::par, query); }
-    );
-    return result;
+    return GetSharedExecutor().Process(search_server, queries);
 }
 
-std::vector<Document> ProcessQueriesJoined(
+JoinedDocuments ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries){
-    std::vector<std::vector<Document>> docs_to_queries = ProcessQueries(search_server, queries);
-    std::vector<Document> result;
-    for(auto docs : docs_to_queries){
-        for(auto doc : docs){
-            result.push_back(doc);
-        }
-    }
-    return result;
-} 
\ No newline at end of file
+    return JoinedDocuments(ProcessQueries(search_server, queries));
+}
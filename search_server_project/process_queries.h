@@ -2,15 +2,132 @@
 
 #include "search_server.h"
 #include "document.h"
+#include "work_stealing_pool.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
 #include <string>
+#include <thread>
 #include <vector>
 #include <string_view>
 
+// Documents found by a batch of queries, in the order of queries, read in place from the
+// results of every query rather than copied into one vector
+class JoinedDocuments {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Document;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Document*;
+        using reference = const Document&;
+
+        Iterator(const std::vector<Document>* query, const std::vector<Document>* last_query)
+            : query_(query)
+            , last_query_(last_query) {
+            SkipEmptyQueries();
+        }
+
+        reference operator*() const {
+            return (*query_)[index_];
+        }
+
+        pointer operator->() const {
+            return &(*query_)[index_];
+        }
+
+        Iterator& operator++() {
+            if (++index_ == query_->size()) {
+                ++query_;
+                index_ = 0;
+                SkipEmptyQueries();
+            }
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return query_ == other.query_ && index_ == other.index_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        const std::vector<Document>* query_;
+        const std::vector<Document>* last_query_;
+        size_t index_ = 0;
+
+        void SkipEmptyQueries() {
+            while (query_ != last_query_ && query_->empty()) {
+                ++query_;
+            }
+        }
+    };
+
+    explicit JoinedDocuments(std::vector<std::vector<Document>> results);
+
+    Iterator begin() const {
+        return Iterator(results_.data(), results_.data() + results_.size());
+    }
+
+    Iterator end() const {
+        return Iterator(results_.data() + results_.size(), results_.data() + results_.size());
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // Documents of every query
+    const std::vector<std::vector<Document>>& GetResults() const {
+        return results_;
+    }
+
+private:
+    std::vector<std::vector<Document>> results_;
+    size_t size_ = 0;
+};
+
+// Runs batches of queries on a fixed pool of threads, each query scored sequentially on one
+// of them. Queries are planned by their posting count: an expensive query is split into parts
+// of the ordinal range scored by different threads, cheap ones are grouped until a task is
+// worth scheduling.
+class QueryExecutor {
+public:
+    // Postings a task should at least score to outweigh its scheduling
+    static constexpr size_t DEFAULT_MIN_TASK_COST = 1 << 14;
+    // Tasks planned per thread, so that stealing can even out misestimated costs
+    static constexpr size_t TASKS_PER_THREAD = 4;
+
+    explicit QueryExecutor(size_t thread_count = std::max(1u, std::thread::hardware_concurrency()),
+                           size_t min_task_cost = DEFAULT_MIN_TASK_COST);
+
+    // Results of FindTopDocuments for every query, in the order of queries
+    std::vector<std::vector<Document>> Process(const SearchServer& search_server, const std::vector<std::string>& queries);
+
+private:
+    WorkStealingPool pool_;
+    size_t min_task_cost_;
+};
+
+// Both run on an executor shared by all callers
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries); 
 
-std::vector<Document> ProcessQueriesJoined(
+JoinedDocuments ProcessQueriesJoined(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries); 
\ No newline at end of file
+    const std::vector<std::string>& queries); 
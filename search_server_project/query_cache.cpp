@@ -0,0 +1,89 @@
+#include "query_cache.h"
+
+#include <algorithm>
+
+using namespace std;
+
+string MakeQueryKey(const SearchServer::CompiledQuery& query, DocumentStatus status) {
+    SearchServer::QueryTermIds plus_term_ids = query.plus_term_ids;
+    SearchServer::QueryTermIds minus_term_ids = query.minus_term_ids;
+    sort(plus_term_ids.begin(), plus_term_ids.end());
+    sort(minus_term_ids.begin(), minus_term_ids.end());
+    string key;
+    key.reserve(sizeof(int) * (3 + plus_term_ids.size() + minus_term_ids.size()));
+    const auto append = [&key](int value) {
+        key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    append(static_cast<int>(status));
+    append(static_cast<int>(plus_term_ids.size()));
+    for (const int term_id : plus_term_ids) {
+        append(term_id);
+    }
+    append(static_cast<int>(minus_term_ids.size()));
+    for (const int term_id : minus_term_ids) {
+        append(term_id);
+    }
+    return key;
+}
+
+QueryCache::QueryCache(size_t byte_budget)
+    : byte_budget_(byte_budget) {
+}
+
+const vector<Document>* QueryCache::Find(const string& key, uint64_t index_generation) {
+    SetGeneration(index_generation);
+    const auto it = index_.find(key);
+    if (it == index_.end()) {
+        return nullptr;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return &it->second->documents;
+}
+
+void QueryCache::Insert(const string& key, uint64_t index_generation, vector<Document> documents) {
+    SetGeneration(index_generation);
+    if (const auto it = index_.find(key); it != index_.end()) {
+        Erase(it->second);
+    }
+    entries_.push_front({key, move(documents)});
+    const size_t entry_bytes = GetEntryBytes(entries_.front());
+    if (entry_bytes > byte_budget_) {
+        entries_.pop_front();
+        return;
+    }
+    index_.emplace(entries_.front().key, entries_.begin());
+    byte_count_ += entry_bytes;
+    while (byte_count_ > byte_budget_) {
+        Erase(prev(entries_.end()));
+    }
+}
+
+size_t QueryCache::GetEntryCount() const {
+    return entries_.size();
+}
+
+size_t QueryCache::GetByteCount() const {
+    return byte_count_;
+}
+
+size_t QueryCache::GetEntryBytes(const Entry& entry) {
+    // List node, hash node and the heap blocks of the key and the results
+    return sizeof(Entry) + 4 * sizeof(void*) + sizeof(pair<string_view, list<Entry>::iterator>) + 2 * sizeof(void*)
+           + entry.key.capacity() + entry.documents.capacity() * sizeof(Document);
+}
+
+void QueryCache::SetGeneration(uint64_t index_generation) {
+    if (index_generation == index_generation_) {
+        return;
+    }
+    index_.clear();
+    entries_.clear();
+    byte_count_ = 0;
+    index_generation_ = index_generation;
+}
+
+void QueryCache::Erase(list<Entry>::iterator it) {
+    byte_count_ -= GetEntryBytes(*it);
+    index_.erase(it->key);
+    entries_.erase(it);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "document.h"
+#include "search_server.h"
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Normalized form of a query: the same sets of indexed plus and minus words with the same
+// status give the same key, whatever the word order, repetitions, stop words or unknown words.
+std::string MakeQueryKey(const SearchServer::CompiledQuery& query, DocumentStatus status);
+
+// Least recently used search results within a byte budget. Results belong to the index
+// generation they were computed for; the first access with a newer generation drops them all.
+class QueryCache {
+public:
+    explicit QueryCache(size_t byte_budget);
+
+    // Returns nullptr on a miss; the pointer stays valid until the next Insert
+    const std::vector<Document>* Find(const std::string& key, uint64_t index_generation);
+
+    // Results larger than the whole budget are not kept
+    void Insert(const std::string& key, uint64_t index_generation, std::vector<Document> documents);
+
+    size_t GetEntryCount() const;
+
+    size_t GetByteCount() const;
+
+private:
+    struct Entry {
+        std::string key;
+        std::vector<Document> documents;
+    };
+
+    static size_t GetEntryBytes(const Entry& entry);
+
+    void SetGeneration(uint64_t index_generation);
+
+    void Erase(std::list<Entry>::iterator it);
+
+    // Most recently used first
+    std::list<Entry> entries_;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index_;
+    size_t byte_budget_;
+    size_t byte_count_ = 0;
+    uint64_t index_generation_ = 0;
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+// Random words, documents and queries for benchmarks
+
+std::string GenerateWord(std::mt19937& generator, int max_length);
+
+// Up to word_count distinct words of 1 to max_length letters
+std::vector<std::string> GenerateDictionary(std::mt19937& generator, int word_count, int max_length);
+
+// word_count words of the dictionary, each one prefixed by '-' with probability minus_prob
+std::string GenerateQuery(std::mt19937& generator, const std::vector<std::string>& dictionary, int word_count, double minus_prob = 0);
+
+std::vector<std::string> GenerateQueries(std::mt19937& generator, const std::vector<std::string>& dictionary, int query_count,
+                                         int max_word_count, double minus_prob = 0);
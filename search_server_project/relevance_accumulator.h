@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Dense relevance buffer for the documents of one ordinal range [first, last).
+// Only touched slots are reset by Clear, so a thread reuses one buffer for all its queries
+// and never pays for zeroing the whole range. Reset clears slots a query left touched, for
+// one which was left by an exception.
+class RelevanceAccumulator {
+public:
+    enum class State : uint8_t {
+        UNSEEN,
+        ACCEPTED,
+        REJECTED,
+        EXCLUDED,
+    };
+
+    void Reset(int first_ordinal, int last_ordinal) {
+        Clear();
+        first_ordinal_ = first_ordinal;
+        const size_t size = static_cast<size_t>(last_ordinal - first_ordinal);
+        if (states_.size() < size) {
+            states_.resize(size, State::UNSEEN);
+            relevances_.resize(size);
+        }
+    }
+
+    State GetState(int ordinal) const {
+        return states_[ordinal - first_ordinal_];
+    }
+
+    void Accept(int ordinal) {
+        states_[ordinal - first_ordinal_] = State::ACCEPTED;
+        relevances_[ordinal - first_ordinal_] = 0.0;
+        touched_.push_back(ordinal);
+    }
+
+    void Reject(int ordinal) {
+        states_[ordinal - first_ordinal_] = State::REJECTED;
+        touched_.push_back(ordinal);
+    }
+
+    void Exclude(int ordinal) {
+        State& state = states_[ordinal - first_ordinal_];
+        if (state == State::UNSEEN) {
+            touched_.push_back(ordinal);
+        }
+        state = State::EXCLUDED;
+    }
+
+    void Add(int ordinal, double relevance) {
+        relevances_[ordinal - first_ordinal_] += relevance;
+    }
+
+    size_t GetTouchedCount() const {
+        return touched_.size();
+    }
+
+    template <typename Function>
+    void ForEachAccepted(Function function) const {
+        for (const int ordinal : touched_) {
+            if (states_[ordinal - first_ordinal_] == State::ACCEPTED) {
+                function(ordinal, relevances_[ordinal - first_ordinal_]);
+            }
+        }
+    }
+
+    void Clear() {
+        for (const int ordinal : touched_) {
+            states_[ordinal - first_ordinal_] = State::UNSEEN;
+        }
+        touched_.clear();
+    }
+
+private:
+    int first_ordinal_ = 0;
+    std::vector<State> states_;
+    std::vector<double> relevances_;
+    std::vector<int> touched_;
+};
@@ -0,0 +1,133 @@
+#include "remove_duplicates.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <execution>
+#include <numeric>
+#include <unordered_map>
+
+using namespace std;
+
+namespace {
+
+// 8 bands of 4 rows pair up documents with similarity 0.6 with probability ~0.67
+// and documents with similarity 0.8 with probability ~0.98
+const size_t MINHASH_BAND_COUNT = 8;
+const size_t MINHASH_ROWS_PER_BAND = 4;
+
+using DocumentTerms = vector<pair<int, double>>;
+
+struct Fingerprint {
+    uint64_t words = 0;
+    array<uint64_t, MINHASH_BAND_COUNT> bands = {};
+};
+
+uint64_t Mix(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9ULL;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EBULL;
+    value ^= value >> 31;
+    return value;
+}
+
+Fingerprint ComputeFingerprint(const DocumentTerms& terms, bool with_bands) {
+    Fingerprint fingerprint;
+    fingerprint.words = Mix(terms.size());
+    for (const auto& [term_id, _] : terms) {
+        fingerprint.words = Mix(fingerprint.words ^ static_cast<uint64_t>(term_id));
+    }
+    if (!with_bands) {
+        return fingerprint;
+    }
+    array<uint64_t, MINHASH_BAND_COUNT * MINHASH_ROWS_PER_BAND> signature;
+    signature.fill(UINT64_MAX);
+    for (const auto& [term_id, _] : terms) {
+        const uint64_t term_hash = Mix(static_cast<uint64_t>(term_id));
+        for (size_t i = 0; i < signature.size(); ++i) {
+            signature[i] = min(signature[i], Mix(term_hash + i * 0x9E3779B97F4A7C15ULL));
+        }
+    }
+    for (size_t band = 0; band < MINHASH_BAND_COUNT; ++band) {
+        uint64_t band_hash = band;
+        for (size_t row = 0; row < MINHASH_ROWS_PER_BAND; ++row) {
+            band_hash = Mix(band_hash ^ signature[band * MINHASH_ROWS_PER_BAND + row]);
+        }
+        fingerprint.bands[band] = band_hash;
+    }
+    return fingerprint;
+}
+
+bool HaveSameWords(const DocumentTerms& lhs, const DocumentTerms& rhs) {
+    return equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const auto& lhs_term, const auto& rhs_term) {
+        return lhs_term.first == rhs_term.first;
+    });
+}
+
+double ComputeSimilarity(const DocumentTerms& lhs, const DocumentTerms& rhs) {
+    if (lhs.empty() && rhs.empty()) {
+        return 1.0;
+    }
+    size_t common_count = 0;
+    for (auto lhs_it = lhs.begin(), rhs_it = rhs.begin(); lhs_it != lhs.end() && rhs_it != rhs.end();) {
+        if (lhs_it->first < rhs_it->first) {
+            ++lhs_it;
+        } else if (rhs_it->first < lhs_it->first) {
+            ++rhs_it;
+        } else {
+            ++common_count;
+            ++lhs_it;
+            ++rhs_it;
+        }
+    }
+    return common_count * 1.0 / (lhs.size() + rhs.size() - common_count);
+}
+
+}  // namespace
+
+vector<int> RemoveDuplicates(SearchServer& search_server, double min_similarity) {
+    vector<int> document_ids(search_server.begin(), search_server.end());
+    sort(document_ids.begin(), document_ids.end());
+    const bool find_near_duplicates = min_similarity < 1.0;
+
+    vector<const DocumentTerms*> document_terms(document_ids.size());
+    vector<Fingerprint> fingerprints(document_ids.size());
+    vector<size_t> indexes(document_ids.size());
+    iota(indexes.begin(), indexes.end(), 0);
+    for_each(execution::par, indexes.begin(), indexes.end(), [&](size_t i) {
+        document_terms[i] = &search_server.GetDocumentTerms(document_ids[i]);
+        fingerprints[i] = ComputeFingerprint(*document_terms[i], find_near_duplicates);
+    });
+
+    // Documents go in ascending id order, so every group keeps its lowest id
+    unordered_map<uint64_t, vector<size_t>> kept_by_words;
+    vector<unordered_map<uint64_t, vector<size_t>>> kept_by_band(find_near_duplicates ? MINHASH_BAND_COUNT : 0);
+    vector<int> duplicate_ids;
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        const DocumentTerms& terms = *document_terms[i];
+        auto& same_fingerprint = kept_by_words[fingerprints[i].words];
+        bool is_duplicate = any_of(same_fingerprint.begin(), same_fingerprint.end(), [&](size_t kept) {
+            return HaveSameWords(terms, *document_terms[kept]);
+        });
+        for (size_t band = 0; band < kept_by_band.size() && !is_duplicate; ++band) {
+            const auto it = kept_by_band[band].find(fingerprints[i].bands[band]);
+            if (it != kept_by_band[band].end()) {
+                is_duplicate = any_of(it->second.begin(), it->second.end(), [&](size_t kept) {
+                    return ComputeSimilarity(terms, *document_terms[kept]) >= min_similarity;
+                });
+            }
+        }
+        if (is_duplicate) {
+            duplicate_ids.push_back(document_ids[i]);
+            continue;
+        }
+        same_fingerprint.push_back(i);
+        for (size_t band = 0; band < kept_by_band.size(); ++band) {
+            kept_by_band[band][fingerprints[i].bands[band]].push_back(i);
+        }
+    }
+
+    search_server.RemoveDocuments(execution::par, duplicate_ids);
+    return duplicate_ids;
+}
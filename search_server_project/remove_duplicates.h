@@ -0,0 +1,14 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <vector>
+
+// Removes every document whose set of words equals the set of a document with a lower id.
+// Each word set is fingerprinted by hashing its sorted term ids, so documents are grouped in
+// time linear in the total number of terms; fingerprint collisions are verified exactly.
+// With min_similarity below 1 near-duplicates are removed too: documents whose Jaccard
+// similarity of word sets reaches min_similarity are paired up through MinHash signatures
+// split into bands, and every candidate pair is verified on the actual word sets.
+// Returns the removed ids in ascending order.
+std::vector<int> RemoveDuplicates(SearchServer& search_server, double min_similarity = 1.0);
@@ -1,13 +1,28 @@
 #include "request_queue.h"
 #include "document.h"
 
-RequestQueue::RequestQueue(const SearchServer& search_server)
-    : search_server_(search_server){
+RequestQueue::RequestQueue(const SearchServer& search_server, size_t cache_byte_budget)
+    : search_server_(search_server)
+    , cache_(cache_byte_budget){
     }
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus search_status) {
-    return AddFindRequest(raw_query, [search_status](int document_id, DocumentStatus status, int rating)
-                                     { return status == search_status; });
+    const auto start_time = std::chrono::steady_clock::now();
+    const auto query = search_server_.CompileQuery(raw_query);
+    const std::string key = MakeQueryKey(query, search_status);
+    std::vector<Document> search_result;
+    if (const auto* cached_result = cache_.Find(key, query.index_generation)) {
+        search_result = *cached_result;
+        ++cache_stats_.hit_count;
+        cache_stats_.hit_time += std::chrono::steady_clock::now() - start_time;
+    } else {
+        search_result = search_server_.FindTopDocuments(std::execution::seq, query, search_status);
+        cache_.Insert(key, query.index_generation, search_result);
+        ++cache_stats_.miss_count;
+        cache_stats_.miss_time += std::chrono::steady_clock::now() - start_time;
+    }
+    empty_results_.Record(search_result.empty());
+    return search_result;
 }
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query) {
@@ -15,5 +30,35 @@ std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query)
 }
 
 int RequestQueue::GetNoResultRequests() const {
-    return empty_requests_;
+    return empty_results_.GetEmptyCount();
+}
+
+const RequestQueue::CacheStats& RequestQueue::GetCacheStats() const {
+    return cache_stats_;
+}
+
+double RequestQueue::CacheStats::GetHitRate() const {
+    const size_t request_count = hit_count + miss_count;
+    return request_count > 0 ? hit_count * 1.0 / request_count : 0.0;
+}
+
+EmptyResultWindow::EmptyResultWindow(size_t window_size)
+    : window_size_(window_size) {
+}
+
+void EmptyResultWindow::Record(bool is_empty) {
+    empty_results_.push_back(is_empty);
+    if (is_empty) {
+        ++empty_count_;
+    }
+    if (empty_results_.size() > window_size_) {
+        if (empty_results_.front()) {
+            --empty_count_;
+        }
+        empty_results_.pop_front();
+    }
+}
+
+int EmptyResultWindow::GetEmptyCount() const {
+    return empty_count_;
 }
@@ -1,13 +1,41 @@
 #pragma once
 #include "search_server.h"
+#include "query_cache.h"
+#include <chrono>
 #include <string>
 #include <vector>
 #include <deque>
 
+// Number of requests with no result among the last window_size ones
+class EmptyResultWindow {
+public:
+    explicit EmptyResultWindow(size_t window_size = 1440);
+
+    void Record(bool is_empty);
+
+    int GetEmptyCount() const;
+
+private:
+    std::deque<bool> empty_results_;
+    size_t window_size_;
+    int empty_count_ = 0;
+};
+
 class RequestQueue {
 public:
-    RequestQueue(const SearchServer& search_server);
+    struct CacheStats {
+        size_t hit_count = 0;
+        size_t miss_count = 0;
+        std::chrono::nanoseconds hit_time{0};
+        std::chrono::nanoseconds miss_time{0};
+
+        double GetHitRate() const;
+    };
 
+    // Requests by status are answered from a cache of recent results within cache_byte_budget
+    RequestQueue(const SearchServer& search_server, size_t cache_byte_budget = 16 << 20);
+
+    // Predicates cannot be compared, so these requests always go to the server
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate);
 
@@ -16,28 +44,19 @@ public:
     std::vector<Document> AddFindRequest(const std::string& raw_query);
 
     int GetNoResultRequests() const;
+
+    // Latencies of cached requests, split into hits and misses
+    const CacheStats& GetCacheStats() const;
 private:
-    struct QueryResult {
-        std::string query;
-        std::vector<Document> search_result;
-    };
-    std::deque<QueryResult> requests_;
-    const static int min_in_day_ = 1440;
     const SearchServer &search_server_;
-    int empty_requests_ = 0;
+    EmptyResultWindow empty_results_;
+    QueryCache cache_;
+    CacheStats cache_stats_;
 };
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
-    requests_.push_back({raw_query, search_server_.FindTopDocuments(raw_query, document_predicate)});
-    if(requests_.back().search_result.empty()){
-        ++empty_requests_;
-    }
-    if(requests_.size() > min_in_day_) {
-        if(requests_.front().search_result.empty()){
-            --empty_requests_;
-        }
-        requests_.pop_front();
-    }
-    return requests_.back().search_result;
+    auto search_result = search_server_.FindTopDocuments(raw_query, document_predicate);
+    empty_results_.Record(search_result.empty());
+    return search_result;
 }
@@ -1,4 +1,5 @@
 #include "search_server.h"
+#include "snapshot_io.h"
 
 #include <cmath>
 #include <iostream>
@@ -6,44 +7,64 @@
 
 using namespace std;
 
+namespace {
+const uint32_t SNAPSHOT_MAGIC = 0x58495353;
+const uint32_t SNAPSHOT_VERSION = 4;
+}
+
 SearchServer::SearchServer(const std::string& stop_words_text)
     : SearchServer(SplitIntoWords(stop_words_text)){}
 
-SearchServer::SearchServer(const std::string_view stop_words_text){
-    SearchServer(static_cast<string>(stop_words_text));
-}
+SearchServer::SearchServer(const std::string_view stop_words_text)
+    : SearchServer(SplitIntoWords(stop_words_text)){}
 
 void SearchServer::AddDocument(int document_id, const string_view document, DocumentStatus status, const vector<int>& ratings) {
-    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+    PROBE_SCOPE("AddDocument");
+    if ((document_id < 0) || (documents_.FindOrdinal(document_id) >= 0)) {
         throw invalid_argument("Invalid document_id"s);
     }
-    const auto words = SearchServer::SplitIntoWordsNoStop(static_cast<string>(document));
-    const double inv_word_count = 1.0 / words.size();
-    for (const string& word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        doc_id_to_words_freqs_[document_id][word_to_document_freqs_.find(word)->first] += inv_word_count;
-    }
-    documents_.emplace(document_id, SearchServer::DocumentData{SearchServer::ComputeAverageRating(ratings), status});
+    const auto words = ComputeTermCounts(document);
+    ++index_generation_;
+    ReleasePurgedOrdinals();
+    IndexDocument(RegisterDocument(document_id, SearchServer::ComputeAverageRating(ratings), status, words.word_count), words);
     document_ids_.push_back(document_id);
+    word_to_document_freqs_.FlushBufferIfFull();
+}
+
+void SearchServer::AddDocuments(const vector<RawDocument>& documents) {
+    AddDocuments(std::execution::seq, documents);
 }
 
-vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(std::execution::seq, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-                                                             return document_status == status;});    
+void SearchServer::SetDocumentStatus(int document_id, DocumentStatus status) {
+    const int ordinal = documents_.FindOrdinal(document_id);
+    if (ordinal < 0) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    if (documents_.GetStatus(ordinal) == status) {
+        return;
+    }
+    ++index_generation_;
+    documents_.SetStatus(ordinal, status);
+}
+
+vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status, size_t max_result_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, StatusFilter{status}, max_result_count);
 }
 
 vector<Document> SearchServer::FindTopDocuments(const string_view raw_query) const {
-    return FindTopDocuments(std::execution::seq, raw_query, [](int document_id, DocumentStatus document_status, int rating) {
-        return document_status ==  DocumentStatus::ACTUAL;
-    });
+    return FindTopDocuments(std::execution::seq, raw_query, StatusFilter{DocumentStatus::ACTUAL});
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const{
     return MatchDocument(std::execution::seq, raw_query, document_id);
 }
 
+vector<tuple<vector<string_view>, DocumentStatus>> SearchServer::MatchDocuments(string_view raw_query, const vector<int>& document_ids) const {
+    return MatchDocuments(std::execution::seq, raw_query, document_ids);
+}
+
 int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return documents_.GetDocumentCount();
 }
 
 int SearchServer::GetDocumentId(int index) const {
@@ -58,19 +79,30 @@ vector<int>::iterator SearchServer::end(){
     return document_ids_.end();
 }
 
-const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    if(doc_id_to_words_freqs_.count(document_id)){
-        return doc_id_to_words_freqs_.at(document_id);
-    } else return dummy_;
+map<string_view, double> SearchServer::GetWordFrequencies(int document_id) const {
+    map<string_view, double> word_freqs;
+    const int ordinal = documents_.FindOrdinal(document_id);
+    if(ordinal >= 0){
+        for (const auto& [term_id, term_freq] : ordinal_to_term_freqs_[ordinal]) {
+            word_freqs.emplace(word_to_document_freqs_.GetTerm(term_id), term_freq);
+        }
+    }
+    return word_freqs;
 }
 
-bool SearchServer::IsStopWord(const string& word) const {
+const vector<pair<int, double>>& SearchServer::GetDocumentTerms(int document_id) const {
+    static const vector<pair<int, double>> empty_terms;
+    const int ordinal = documents_.FindOrdinal(document_id);
+    return ordinal >= 0 ? ordinal_to_term_freqs_[ordinal] : empty_terms;
+}
+
+bool SearchServer::IsStopWord(string_view word) const {
     return stop_words_.count(word) > 0;
 }
 
-vector<string> SearchServer::SplitIntoWordsNoStop(const string& text) const {
-    vector<string> words;
-    for (const string& word : SplitIntoWords(text)) {
+vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const {
+    vector<string_view> words;
+    for (const string_view word : SplitIntoWords(text)) {
         if (!IsValidWord(word)) {
             throw invalid_argument("Word is invalid"s);
         }
@@ -81,21 +113,125 @@ vector<string> SearchServer::SplitIntoWordsNoStop(const string& text) const {
     return words;
 }
 
+SearchServer::DocumentWords SearchServer::ComputeTermCounts(string_view text) const {
+    auto words = SplitIntoWordsNoStop(text);
+    sort(words.begin(), words.end());
+    DocumentWords result;
+    result.word_count = static_cast<int>(words.size());
+    for (auto it = words.begin(); it != words.end();) {
+        const auto next = upper_bound(it, words.end(), *it);
+        result.term_counts.emplace_back(*it, static_cast<int>(next - it));
+        it = next;
+    }
+    return result;
+}
+
+int SearchServer::RegisterDocument(int document_id, int rating, DocumentStatus status, int word_count) {
+    const int ordinal = documents_.Add(document_id, rating, status, word_count);
+    if (ordinal == static_cast<int>(ordinal_to_term_freqs_.size())) {
+        ordinal_to_term_freqs_.emplace_back();
+    }
+    return ordinal;
+}
+
+void SearchServer::IndexDocument(int ordinal, const DocumentWords& words) {
+    auto& document_terms = ordinal_to_term_freqs_[ordinal];
+    document_terms.reserve(words.term_counts.size());
+    for (const auto& [word, term_count] : words.term_counts) {
+        const int term_id = word_to_document_freqs_.AddPosting(word, ordinal, term_count);
+        word_to_document_freqs_.RaiseTermFreqBound(term_id, term_count, documents_.GetInverseWordCount(ordinal));
+        document_terms.emplace_back(term_id, documents_.GetTermFreq(ordinal, term_count));
+    }
+    sort(document_terms.begin(), document_terms.end());
+}
+
+SearchServer::PartialIndex SearchServer::BuildPartialIndex(const vector<DocumentWords>& batch_words, const vector<int>& ordinals,
+                                                           size_t first, size_t last) {
+    PartialIndex partial_index;
+    for (size_t i = first; i < last; ++i) {
+        for (const auto& [word, term_count] : batch_words[i].term_counts) {
+            const auto [it, inserted] = partial_index.local_ids.emplace(word, static_cast<int>(partial_index.terms.size()));
+            if (inserted) {
+                partial_index.terms.push_back(word);
+                partial_index.postings.emplace_back();
+            }
+            partial_index.postings[it->second].emplace_back(ordinals[i], term_count);
+        }
+    }
+    return partial_index;
+}
+
+void SearchServer::MergePartialIndex(PartialIndex& partial_index) {
+    partial_index.term_ids.resize(partial_index.terms.size());
+    for (size_t local_id = 0; local_id < partial_index.terms.size(); ++local_id) {
+        const int term_id = word_to_document_freqs_.AddPostings(partial_index.terms[local_id], partial_index.postings[local_id]);
+        for (const auto& [ordinal, term_count] : partial_index.postings[local_id]) {
+            word_to_document_freqs_.RaiseTermFreqBound(term_id, term_count, documents_.GetInverseWordCount(ordinal));
+        }
+        partial_index.term_ids[local_id] = term_id;
+    }
+}
+
+void SearchServer::FillForwardIndex(const PartialIndex& partial_index, const vector<DocumentWords>& batch_words,
+                                    const vector<int>& ordinals, size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+        auto& document_terms = ordinal_to_term_freqs_[ordinals[i]];
+        document_terms.reserve(batch_words[i].term_counts.size());
+        for (const auto& [word, term_count] : batch_words[i].term_counts) {
+            document_terms.emplace_back(partial_index.term_ids[partial_index.local_ids.at(word)], documents_.GetTermFreq(ordinals[i], term_count));
+        }
+        sort(document_terms.begin(), document_terms.end());
+    }
+}
+
+vector<int> SearchServer::CollectTermIds(const vector<int>& ordinals) const {
+    vector<int> term_ids;
+    for (const int ordinal : ordinals) {
+        for (const auto& [term_id, _] : ordinal_to_term_freqs_[ordinal]) {
+            term_ids.push_back(term_id);
+        }
+    }
+    sort(term_ids.begin(), term_ids.end());
+    term_ids.erase(unique(term_ids.begin(), term_ids.end()), term_ids.end());
+    return term_ids;
+}
+
+void SearchServer::FinishRemoval(const vector<int>& ordinals, const vector<int>& purged_ordinals, const vector<int>& term_ids) {
+    for (const int term_id : term_ids) {
+        word_to_document_freqs_.ReleaseTermIfUnused(term_id);
+    }
+    for (const int ordinal : ordinals) {
+        ordinal_to_term_freqs_[ordinal] = {};
+    }
+    for (const int ordinal : purged_ordinals) {
+        documents_.Release(ordinal);
+    }
+    document_ids_.erase(remove_if(document_ids_.begin(), document_ids_.end(), [this](int document_id) {
+        return documents_.FindOrdinal(document_id) < 0;
+    }), document_ids_.end());
+}
+
+void SearchServer::ReleasePurgedOrdinals() {
+    for (const int ordinal : word_to_document_freqs_.TakePurgedOrdinals()) {
+        documents_.Release(ordinal);
+    }
+}
+
 struct SearchServer::QueryWord {
-    string data;
+    string_view data;
     bool is_minus;
     bool is_stop;
 };
 
- SearchServer::QueryWord SearchServer::ParseQueryWord(const string& text) const {
+ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
     if (text.empty()) {
         throw invalid_argument("Query word is empty"s);
     }
-    string word = text;
+    string_view word = text;
     bool is_minus = false;
     if (word[0] == '-') {
         is_minus = true;
-        word = word.substr(1);
+        word.remove_prefix(1);
     }
     if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
         throw invalid_argument("Query word is invalid");
@@ -103,25 +239,197 @@ struct SearchServer::QueryWord {
     return {word, is_minus, IsStopWord(word)};
 }
 
- SearchServer::Query SearchServer::ParseQuery(const string& text) const {
-    Query result;
-    for (const string& word : SplitIntoWords(text)) {
+void SearchServer::ParseQuery(string_view text, Query& result) const {
+    PROBE_SCOPE("ParseQuery");
+    result.plus_words.clear();
+    result.minus_words.clear();
+    ForEachWord(text, [&result, this](string_view word) {
         const auto query_word = ParseQueryWord(word);
         if (!query_word.is_stop) {
             if (query_word.is_minus) {
-                result.minus_words.insert(query_word.data);
+                result.minus_words.push_back(query_word.data);
             } else {
-            result.plus_words.insert(query_word.data);
+                result.plus_words.push_back(query_word.data);
             }
         }
+    });
+    for (auto* words : {&result.plus_words, &result.minus_words}) {
+        sort(words->begin(), words->end());
+        words->resize(unique(words->begin(), words->end()) - words->begin());
     }
-    return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const string& word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+pair<const int*, size_t> SearchServer::CollectOrdinals(const vector<PostingRun>& runs, int first_ordinal, int last_ordinal,
+                                                     vector<int>& buffer) {
+    if (runs.size() == 1 && runs[0].segment == nullptr) {
+        const int* first = lower_bound(runs[0].ordinals, runs[0].ordinals + runs[0].size, first_ordinal);
+        const int* last = lower_bound(first, runs[0].ordinals + runs[0].size, last_ordinal);
+        return {first, static_cast<size_t>(last - first)};
+    }
+    buffer.clear();
+    for (const PostingRun& run : runs) {
+        const size_t middle = buffer.size();
+        ForEachPostingSlice(run, first_ordinal, last_ordinal, [&buffer](const int* ordinals, const uint32_t*, size_t size) {
+            buffer.insert(buffer.end(), ordinals, ordinals + size);
+        });
+        inplace_merge(buffer.begin(), buffer.begin() + middle, buffer.end());
+    }
+    buffer.erase(unique(buffer.begin(), buffer.end()), buffer.end());
+    return {buffer.data(), buffer.size()};
+}
+
+SearchServer::CompiledQuery SearchServer::CompileQuery(string_view raw_query) const {
+    // Reused by the queries of the thread, so words past the inline capacity allocate only once
+    static thread_local Query query;
+    ParseQuery(raw_query, query);
+    CompiledQuery compiled_query;
+    compiled_query.index_generation = index_generation_;
+    for (auto [words, term_ids] : {pair{&query.plus_words, &compiled_query.plus_term_ids},
+                                   pair{&query.minus_words, &compiled_query.minus_term_ids}}) {
+        for (const string_view word : *words) {
+            const int term_id = word_to_document_freqs_.FindTermId(word);
+            if (term_id >= 0 && word_to_document_freqs_.GetDocumentFreq(term_id) > 0) {
+                term_ids->push_back(term_id);
+            }
+        }
+    }
+    return compiled_query;
+}
+
+SearchServer::CompiledQuery SearchServer::CompileMatchQuery(string_view raw_query) const {
+    CompiledQuery query = CompileQuery(raw_query);
+    sort(query.plus_term_ids.begin(), query.plus_term_ids.end());
+    sort(query.minus_term_ids.begin(), query.minus_term_ids.end());
+    return query;
+}
+
+vector<Document> SearchServer::FindTopDocumentsPart(const CompiledQuery& query, DocumentStatus status, size_t part, size_t part_count,
+                                                   size_t max_result_count) const {
+    return FindTopDocumentsPart(query, StatusFilter{status}, part, part_count, max_result_count);
+}
+
+size_t SearchServer::EstimateQueryCost(const CompiledQuery& query) const {
+    size_t cost = 0;
+    for (const int term_id : query.plus_term_ids) {
+        cost += word_to_document_freqs_.GetDocumentFreq(term_id);
+    }
+    return cost;
+}
+
+uint64_t SearchServer::GetIndexGeneration() const {
+    return index_generation_;
+}
+
+void SearchServer::SetParallelShardCount(size_t shard_count) {
+    parallel_shard_count_ = max<size_t>(1, shard_count);
+}
+
+size_t SearchServer::GetParallelShardCount() const {
+    return parallel_shard_count_;
+}
+
+void SearchServer::SetRetrievalMode(RetrievalMode mode) {
+    retrieval_mode_ = mode;
+}
+
+RetrievalMode SearchServer::GetRetrievalMode() const {
+    return retrieval_mode_;
+}
+
+void SearchServer::SetIndexBufferLimit(size_t posting_count) {
+    word_to_document_freqs_.SetBufferLimit(posting_count);
+}
+
+size_t SearchServer::GetIndexSegmentCount() const {
+    return word_to_document_freqs_.GetSegmentCount();
+}
+
+void SearchServer::CompactIndex() {
+    word_to_document_freqs_.Compact();
+    ReleasePurgedOrdinals();
+    for (auto& document_terms : ordinal_to_term_freqs_) {
+        document_terms.shrink_to_fit();
+    }
+    document_ids_.shrink_to_fit();
 }
 
 set<string> SearchServer::GetStopWords() const{
-    return stop_words_;
+    return {stop_words_.begin(), stop_words_.end()};
+}
+
+void SearchServer::SaveIndex(const string& path) const {
+    SnapshotWriter writer(path);
+    writer.Write(SNAPSHOT_MAGIC);
+    writer.Write(SNAPSHOT_VERSION);
+    writer.Write<uint64_t>(stop_words_.size());
+    for (const string& word : stop_words_) {
+        writer.Write<uint32_t>(static_cast<uint32_t>(word.size()));
+        writer.WriteBytes(word);
+    }
+    documents_.WriteSnapshot(writer);
+    word_to_document_freqs_.WriteSnapshot(writer);
+
+    writer.Write<uint64_t>(ordinal_to_term_freqs_.size());
+    for (const auto& document_terms : ordinal_to_term_freqs_) {
+        writer.Write<uint64_t>(document_terms.size());
+    }
+    for (const auto& document_terms : ordinal_to_term_freqs_) {
+        for (const auto& [term_id, term_freq] : document_terms) {
+            writer.Write(term_id);
+            writer.Write(term_freq);
+        }
+    }
+    writer.Write<uint64_t>(document_ids_.size());
+    writer.WriteArray(document_ids_.data(), document_ids_.size());
+    writer.Finish();
+}
+
+SearchServer SearchServer::LoadIndex(const string& path) {
+    auto snapshot = make_shared<const MappedFile>(path);
+    SnapshotReader reader(snapshot->data(), snapshot->size());
+    if (reader.Read<uint32_t>() != SNAPSHOT_MAGIC) {
+        throw runtime_error("Not a search server snapshot: "s + path);
+    }
+    if (reader.Read<uint32_t>() != SNAPSHOT_VERSION) {
+        throw runtime_error("Unsupported snapshot version: "s + path);
+    }
+    // Counts are not trusted with allocations before the values they count are read
+    const size_t stop_word_count = reader.Read<uint64_t>();
+    vector<string_view> stop_words;
+    for (size_t i = 0; i < stop_word_count; ++i) {
+        stop_words.push_back(reader.ReadBytes(reader.Read<uint32_t>()));
+        CheckSnapshot(IsValidWord(stop_words.back()));
+    }
+
+    SearchServer search_server(stop_words);
+    search_server.documents_.ReadSnapshot(reader);
+    const int ordinal_count = search_server.documents_.GetOrdinalCount();
+    search_server.word_to_document_freqs_.ReadSnapshot(reader, ordinal_count);
+    const int term_id_count = search_server.word_to_document_freqs_.GetTermIdCount();
+
+    auto& ordinal_to_term_freqs = search_server.ordinal_to_term_freqs_;
+    CheckSnapshot(reader.Read<uint64_t>() == static_cast<size_t>(ordinal_count));
+    const uint64_t* term_counts = reader.ReadArray<uint64_t>(ordinal_count);
+    ordinal_to_term_freqs.resize(ordinal_count);
+    for (int ordinal = 0; ordinal < ordinal_count; ++ordinal) {
+        CheckSnapshot(term_counts[ordinal] <= static_cast<size_t>(term_id_count));
+        auto& document_terms = ordinal_to_term_freqs[ordinal];
+        document_terms.resize(term_counts[ordinal]);
+        for (auto& [term_id, term_freq] : document_terms) {
+            term_id = reader.Read<int>();
+            term_freq = reader.Read<double>();
+            CheckSnapshot(term_id >= 0 && term_id < term_id_count && term_freq >= 0.0 && isfinite(term_freq));
+        }
+    }
+    const size_t document_id_count = reader.Read<uint64_t>();
+    CheckSnapshot(document_id_count == static_cast<size_t>(search_server.documents_.GetDocumentCount()));
+    const int* document_ids = reader.ReadArray<int>(document_id_count);
+    search_server.document_ids_.assign(document_ids, document_ids + document_id_count);
+    for (const int document_id : search_server.document_ids_) {
+        CheckSnapshot(search_server.documents_.FindOrdinal(document_id) >= 0);
+    }
+
+    search_server.ReleasePurgedOrdinals();
+    search_server.snapshot_ = move(snapshot);
+    return search_server;
 }
@@ -2,8 +2,18 @@
 
 #include "document.h"
 #include "string_processing.h"
-#include "concurrent_map.h"
+#include "document_table.h"
+#include "instrumentation.h"
+#include "inverted_index.h"
+#include "mapped_file.h"
+#include "ordinal_bitmap.h"
+#include "ordinal_set_ops.h"
+#include "posting_cursor.h"
+#include "relevance_accumulator.h"
+#include "small_vector.h"
+#include "top_documents.h"
 
+#include <chrono>
 #include <string>
 #include <string_view>
 #include <set>
@@ -14,12 +24,52 @@
 #include <stdexcept>
 #include <execution>
 #include <initializer_list>
+#include <limits>
 #include <mutex>
+#include <numeric>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
+const size_t MAX_SUBTRACTED_RUN_COUNT = 4;
+const size_t MAX_PRUNED_RUN_COUNT = 32;
+
+// EXHAUSTIVE scores every posting of the query's plus words. PRUNED walks the postings document
+// by document and skips documents whose relevance bound cannot reach the current top results;
+// both return the same documents.
+enum class RetrievalMode {
+    EXHAUSTIVE,
+    PRUNED,
+};
+
+// Thrown by a query whose deadline passes while it is scored
+class DeadlineExceededError : public std::runtime_error {
+public:
+    DeadlineExceededError()
+        : std::runtime_error("Query deadline exceeded") {
+    }
+};
 
 class SearchServer {
 public:
+    // Queries of up to this many plus and minus words each are parsed and compiled without allocating
+    static constexpr size_t INLINE_QUERY_WORD_COUNT = 16;
+
+    using QueryTermIds = SmallVector<int, INLINE_QUERY_WORD_COUNT>;
+
+    // Query words resolved to term ids. Words which are not indexed are dropped: they can
+    // neither add relevance nor exclude documents. Valid while the index generation is the same.
+    // Scoring checks the deadline between posting blocks and throws DeadlineExceededError once it passes.
+    struct CompiledQuery {
+        QueryTermIds plus_term_ids;
+        QueryTermIds minus_term_ids;
+        uint64_t index_generation = 0;
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    };
+
     SearchServer() = default;
     
     template <typename StringContainer>
@@ -31,27 +81,70 @@ public:
 
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+    // Adds all documents or none of them: ids and words of the whole batch are checked first.
+    // Documents are tokenized in parallel and their postings merged into the index in one pass.
+    template <typename ExecutionPolicy, typename DocumentRange>
+    void AddDocuments(ExecutionPolicy&& policy, const DocumentRange& documents);
+
+    void AddDocuments(const std::vector<RawDocument>& documents);
+
     template <typename ExecutionPolicy, typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
     
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query) const;
     
     template <typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status,
+                                           size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
     
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status,
+                                           size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
 
+    CompiledQuery CompileQuery(std::string_view raw_query) const;
+
+    // Throws std::invalid_argument if the query was compiled for another index generation
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const CompiledQuery& query, DocumentPredicate document_predicate,
+                                           size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const CompiledQuery& query, DocumentStatus status,
+                                           size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // Best documents of one of part_count equal ranges of internal ordinals, not sorted. Passing the
+    // results of all parts to SelectTopDocuments gives the result of FindTopDocuments, so a caller
+    // may score the parts of one query on its own threads.
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsPart(const CompiledQuery& query, DocumentPredicate document_predicate, size_t part,
+                                               size_t part_count, size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    std::vector<Document> FindTopDocumentsPart(const CompiledQuery& query, DocumentStatus status, size_t part, size_t part_count,
+                                               size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // Number of postings of the query's plus words, which the work of scoring the query is proportional to
+    size_t EstimateQueryCost(const CompiledQuery& query) const;
+
+    // Changes whenever documents are added, removed or change status
+    uint64_t GetIndexGeneration() const;
+
     int GetDocumentCount() const;
 
     int GetDocumentId(int index) const;
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // Views into the term pool stay valid until CompactIndex
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+
+    // Distinct words of the document as term ids with their frequencies, sorted by term id.
+    // A term keeps its id while it is indexed. Empty for an unknown document.
+    const std::vector<std::pair<int, double>>& GetDocumentTerms(int document_id) const;
 
     std::vector<int>::iterator begin();
 
@@ -63,40 +156,139 @@ public:
     void RemoveDocument(int document_id){
         RemoveDocument(std::execution::seq, document_id);
     }
+
+    // Tombstones the documents first, so they drop out of search at once, then purges their
+    // buffered postings with the lists split into shards by term. Postings in index segments
+    // are purged by the background merger. Unknown ids are ignored.
+    template <typename ExecutionPolicy, typename IdRange>
+    void RemoveDocuments(ExecutionPolicy&& policy, const IdRange& document_ids);
+
+    // Moves the document to another status without indexing its words again.
+    // Throws std::invalid_argument if there is no document with such id.
+    void SetDocumentStatus(int document_id, DocumentStatus status);
     
+    // Plus words of the query found in the document, sorted, or none if it has a minus word.
+    // Words are views into the term storage. Throws std::out_of_range for an unknown document.
     template<typename ExecutionPolicy>
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(ExecutionPolicy&& policy, const std::string_view raw_query, int document_id) const;
     
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query, int document_id) const;
 
+    // MatchDocument for every document with the query parsed once; the policy spreads the documents
+    template <typename ExecutionPolicy>
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                                                                          const std::vector<int>& document_ids) const;
+
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(std::string_view raw_query,
+                                                                                          const std::vector<int>& document_ids) const;
+
     std::set<std::string> GetStopWords() const;
+
+    // Merges the index into one segment without postings of removed documents and reclaims
+    // the bytes of terms which are no longer indexed.
+    // Invalidates string_views returned by MatchDocument(s) and GetWordFrequencies.
+    void CompactIndex();
+
+    // Number of postings new documents collect in memory before they form an index segment
+    void SetIndexBufferLimit(size_t posting_count);
+
+    size_t GetIndexSegmentCount() const;
+
+    // Number of independent parts which parallel queries and batch additions split their work into
+    void SetParallelShardCount(size_t shard_count);
+
+    size_t GetParallelShardCount() const;
+
+    // Queries with more than MAX_PRUNED_RUN_COUNT posting runs are always scored exhaustively
+    void SetRetrievalMode(RetrievalMode mode);
+
+    RetrievalMode GetRetrievalMode() const;
+
+    // Writes stop words, term dictionary, postings, document table and forward index
+    // to a versioned binary file. Throws std::runtime_error on I/O failure.
+    void SaveIndex(const std::string& path) const;
+
+    // Maps a file written by SaveIndex. Postings are served straight from the mapping,
+    // which stays open while the server or any of its copies is alive. Throws
+    // std::runtime_error if the file is truncated or holds ids and offsets out of range.
+    static SearchServer LoadIndex(const std::string& path);
     
 private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-    };
     struct QueryWord;
+    // Sorted unique views into the raw query text
     struct Query {
-        std::set<std::string> plus_words;
-        std::set<std::string> minus_words;
+        SmallVector<std::string_view, INLINE_QUERY_WORD_COUNT> plus_words;
+        SmallVector<std::string_view, INLINE_QUERY_WORD_COUNT> minus_words;
+    };
+    // Predicate of the status overloads; FindAllDocuments recognizes it and tests the status
+    // bitmap of the document table instead of calling it
+    struct StatusFilter {
+        DocumentStatus status;
+
+        bool operator()(int document_id, DocumentStatus document_status, int rating) const {
+            return document_status == status;
+        }
     };
-    const std::set<std::string> stop_words_;
-    std::map<std::string, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> doc_id_to_words_freqs_;
-    std::map<int, DocumentData> documents_;
+    const std::set<std::string, std::less<>> stop_words_;
+    // Backs borrowed terms and postings of a loaded index. Declared before the index, so the
+    // mapping outlives the index's merger thread, which may still read borrowed segments.
+    std::shared_ptr<const MappedFile> snapshot_;
+    InvertedIndex word_to_document_freqs_;
+    // Term ids with their frequencies sorted by term id, indexed by ordinal
+    std::vector<std::vector<std::pair<int, double>>> ordinal_to_term_freqs_;
+    DocumentTable documents_;
     std::vector<int> document_ids_;
-    const std::map<std::string_view, double> dummy_;
+    size_t parallel_shard_count_ = std::max(1u, std::thread::hardware_concurrency());
+    RetrievalMode retrieval_mode_ = RetrievalMode::PRUNED;
+    uint64_t index_generation_ = 0;
 
-    bool IsStopWord(const std::string& word) const;
+    bool IsStopWord(std::string_view word) const;
 
-    static bool IsValidWord(const std::string& word) {
+    static bool IsValidWord(std::string_view word) {
         return std::none_of(word.begin(), word.end(), [](char c) {
             return c >= '\0' && c < ' ';
         });
     }
 
-    std::vector<std::string> SplitIntoWordsNoStop(const std::string& text) const;
+    std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
+
+    // Distinct words of a document with the number of their occurrences, sorted by word
+    struct DocumentWords {
+        std::vector<std::pair<std::string_view, int>> term_counts;
+        int word_count = 0;
+    };
+
+    DocumentWords ComputeTermCounts(std::string_view text) const;
+
+    // Returns the ordinal of the new document
+    int RegisterDocument(int document_id, int rating, DocumentStatus status, int word_count);
+
+    void IndexDocument(int ordinal, const DocumentWords& words);
+
+    // Postings of a chunk of a batch, numbered by chunk-local term ids
+    struct PartialIndex {
+        std::unordered_map<std::string_view, int> local_ids;
+        std::vector<std::string_view> terms;
+        std::vector<std::vector<std::pair<int, int>>> postings;
+        std::vector<int> term_ids;
+    };
+
+    static PartialIndex BuildPartialIndex(const std::vector<DocumentWords>& batch_words, const std::vector<int>& ordinals,
+                                          size_t first, size_t last);
+
+    void MergePartialIndex(PartialIndex& partial_index);
+
+    void FillForwardIndex(const PartialIndex& partial_index, const std::vector<DocumentWords>& batch_words,
+                          const std::vector<int>& ordinals, size_t first, size_t last);
+
+    // Distinct term ids of the documents, sorted
+    std::vector<int> CollectTermIds(const std::vector<int>& ordinals) const;
+
+    // Releases the purged ordinals and terms left without documents
+    void FinishRemoval(const std::vector<int>& ordinals, const std::vector<int>& purged_ordinals, const std::vector<int>& term_ids);
+
+    // Hands out ordinals whose postings the index merger has dropped
+    void ReleasePurgedOrdinals();
 
     static int ComputeAverageRating(const std::vector<int>& ratings) {
         if (ratings.empty()) {
@@ -109,14 +301,53 @@ private:
         return rating_sum / static_cast<int>(ratings.size());
     }
 
-    QueryWord ParseQueryWord(const std::string& text) const;
+    QueryWord ParseQueryWord(std::string_view text) const;
+
+    // Ordinals of the runs within [first_ordinal, last_ordinal) as one sorted run without repeats.
+    // A single buffered run is returned in place, others are decoded and merged into the buffer.
+    static std::pair<const int*, size_t> CollectOrdinals(const std::vector<PostingRun>& runs, int first_ordinal, int last_ordinal,
+                                                         std::vector<int>& buffer);
+
+    // Replaces the words of result, keeping its buffers
+    void ParseQuery(std::string_view text, Query& result) const;
 
-    Query ParseQuery(const std::string& text) const;
+    // Compiled query with both term id lists sorted, as the forward index is
+    CompiledQuery CompileMatchQuery(std::string_view raw_query) const;
+
+    // Calls on_match(i) for every term_ids[i] found in the document terms, both sorted by term id.
+    // Query terms are few and document terms many, so the search gallops through the latter.
+    template <typename TermCallback>
+    static void ForEachMatchedTerm(const QueryTermIds& term_ids, const std::vector<std::pair<int, double>>& document_terms,
+                                   TermCallback on_match);
+
+    template <typename ExecutionPolicy>
+    std::vector<std::string_view> MatchOrdinal(ExecutionPolicy&& policy, const CompiledQuery& query, int ordinal) const;
+
+    // Postings of a plus word with bounds of the relevance one posting adds: overall and per term count
+    struct ScoredRun {
+        PostingRun postings;
+        double inverse_document_freq;
+        double max_relevance;
+        double max_relevance_per_count;
+    };
 
-    double ComputeWordInverseDocumentFreq(const std::string& word) const;
+    // MaxScore over the shard's ordinals: runs whose bounds sum below the relevance of the worst
+    // top document are only probed for documents found in the other runs, and a probe is skipped
+    // once the block bounds rule the document out. Relevances are summed in the order of runs,
+    // so they equal exhaustive ones to the last bit.
+    // accepts(ordinal) tells whether an alive document is wanted by the query's predicate. If status_ordinals
+    // is not null, it holds every document accepts may take, and the cursors jump straight to them.
+    // Scoring stops early once is_expired() is true.
+    template <typename OrdinalPredicate, typename ExpiryCheck>
+    void ScoreShardPruned(const std::vector<ScoredRun>& runs, const int* excluded_ordinals, size_t excluded_count,
+                          int first_ordinal, int last_ordinal, const OrdinalPredicate& accepts, const OrdinalBitmap* status_ordinals,
+                          const ExpiryCheck& is_expired,
+                          size_t max_result_count, std::vector<Document>& top_documents) const;
 
+    // Returns up to max_result_count best documents of every shard of [first_ordinal, last_ordinal), not sorted
     template <class DocumentPredicate, typename ExecutionPolicy>
-    std::vector<Document> FindAllDocuments(ExecutionPolicy&& policy, const Query& query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindAllDocuments(ExecutionPolicy&& policy, const CompiledQuery& query, DocumentPredicate document_predicate,
+                                           size_t max_result_count, int first_ordinal, int last_ordinal) const;
 };
 
 
@@ -130,106 +361,525 @@ SearchServer::SearchServer(const StringContainer& stop_words)
     }
 }
 
+template <typename ExecutionPolicy, typename DocumentRange>
+void SearchServer::AddDocuments(ExecutionPolicy&& policy, const DocumentRange& documents) {
+    PROBE_SCOPE("AddDocuments");
+    std::vector<const RawDocument*> batch;
+    std::unordered_set<int> batch_ids;
+    for (const RawDocument& document : documents) {
+        if ((document.id < 0) || (documents_.FindOrdinal(document.id) >= 0) || !batch_ids.insert(document.id).second) {
+            throw std::invalid_argument("Invalid document_id");
+        }
+        batch.push_back(&document);
+    }
+
+    std::vector<size_t> indexes(batch.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::vector<DocumentWords> batch_words(batch.size());
+    std::atomic_bool has_invalid_word = false;
+    std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t i) {
+        try {
+            batch_words[i] = ComputeTermCounts(batch[i]->text);
+        } catch (const std::invalid_argument&) {
+            has_invalid_word = true;
+        }
+    });
+    if (has_invalid_word) {
+        throw std::invalid_argument("Word is invalid");
+    }
+
+    ++index_generation_;
+    ReleasePurgedOrdinals();
+    std::vector<int> ordinals(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        ordinals[i] = RegisterDocument(batch[i]->id, ComputeAverageRating(batch[i]->ratings), batch[i]->status,
+                                       batch_words[i].word_count);
+        document_ids_.push_back(batch[i]->id);
+    }
+
+    size_t chunk_count = 1;
+    if constexpr (!std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+        chunk_count = std::max<size_t>(1, std::min<size_t>(parallel_shard_count_, batch.size()));
+    }
+    if (chunk_count == 1) {
+        for (size_t i = 0; i < batch.size(); ++i) {
+            IndexDocument(ordinals[i], batch_words[i]);
+        }
+        word_to_document_freqs_.FlushBufferIfFull();
+        return;
+    }
+    std::vector<size_t> chunks(chunk_count);
+    std::iota(chunks.begin(), chunks.end(), 0);
+    std::vector<PartialIndex> partial_indexes(chunk_count);
+    std::for_each(policy, chunks.begin(), chunks.end(), [&](size_t chunk) {
+        partial_indexes[chunk] = BuildPartialIndex(batch_words, ordinals, batch.size() * chunk / chunk_count,
+                                                   batch.size() * (chunk + 1) / chunk_count);
+    });
+    for (PartialIndex& partial_index : partial_indexes) {
+        MergePartialIndex(partial_index);
+    }
+    std::for_each(policy, chunks.begin(), chunks.end(), [&](size_t chunk) {
+        FillForwardIndex(partial_indexes[chunk], batch_words, ordinals, batch.size() * chunk / chunk_count,
+                         batch.size() * (chunk + 1) / chunk_count);
+    });
+    word_to_document_freqs_.FlushBufferIfFull();
+}
+
 template <class DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate,
+                                                     size_t max_result_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, max_result_count);
     }
     
 template <typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query) const{
-    return FindTopDocuments(policy, raw_query, [](int document_id, DocumentStatus document_status, int rating) {
-                                                return document_status == DocumentStatus::ACTUAL;});	
+    return FindTopDocuments(policy, raw_query, StatusFilter{DocumentStatus::ACTUAL});
 }
     
 template <typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status) const{
-    return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-                                                return document_status == status;});	    
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status,
+                                                     size_t max_result_count) const{
+    return FindTopDocuments(policy, raw_query, StatusFilter{status}, max_result_count);
+}
+
+template <class ExecutionPolicy, class DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate,
+                                                     size_t max_result_count) const {
+    return FindTopDocuments(policy, CompileQuery(raw_query), document_predicate, max_result_count);
 }
 
 template <class ExecutionPolicy, class DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate) const {
-    const auto query = ParseQuery(static_cast<std::string>(raw_query));
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-    sort(policy, matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-                                                        if (std::abs(lhs.relevance - rhs.relevance) < 1e-6) {
-                                                            return lhs.rating > rhs.rating;
-                                                        } else {
-                                                            return lhs.relevance > rhs.relevance;
-                                                        }});
-	
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const CompiledQuery& query, DocumentPredicate document_predicate,
+                                                     size_t max_result_count) const {
+    if (query.index_generation != index_generation_) {
+        throw std::invalid_argument("Query is compiled for another index generation");
+    }
+    auto matched_documents = FindAllDocuments(policy, query, document_predicate, max_result_count, 0, documents_.GetOrdinalCount());
+    {
+        PROBE_SCOPE("SelectTopDocuments");
+        SelectTopDocuments(matched_documents, max_result_count);
     }
     return matched_documents;
 }
 
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsPart(const CompiledQuery& query, DocumentPredicate document_predicate, size_t part,
+                                                         size_t part_count, size_t max_result_count) const {
+    if (query.index_generation != index_generation_) {
+        throw std::invalid_argument("Query is compiled for another index generation");
+    }
+    const size_t ordinal_count = documents_.GetOrdinalCount();
+    return FindAllDocuments(std::execution::seq, query, document_predicate, max_result_count, static_cast<int>(ordinal_count * part / part_count),
+                            static_cast<int>(ordinal_count * (part + 1) / part_count));
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const CompiledQuery& query, DocumentStatus status,
+                                                     size_t max_result_count) const {
+    return FindTopDocuments(policy, query, StatusFilter{status}, max_result_count);
+}
+
 template <class DocumentPredicate, typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy&& policy, const SearchServer::Query& query, DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> map_lock(10);    
-    std::for_each(policy, query.plus_words.begin(), query.plus_words.end(), 
-        [document_predicate, &map_lock, this] (const std::string& word){
-            if (word_to_document_freqs_.count(word)) {
-                const double inverse_document_freq = SearchServer::ComputeWordInverseDocumentFreq(word);
-                for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                    const auto& document_data = documents_.at(document_id);
-                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                       map_lock[document_id].ref_to_value += term_freq * inverse_document_freq;
+std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy&& policy, const CompiledQuery& query, DocumentPredicate document_predicate,
+                                                     size_t max_result_count, int first_ordinal, int last_ordinal) const {
+    PROBE_SCOPE("FindAllDocuments");
+    const int document_count = GetDocumentCount();
+    // Held for the whole query, so segments merged meanwhile stay alive
+    const auto segments = word_to_document_freqs_.GetSegments();
+    std::vector<ScoredRun> plus_postings;
+    plus_postings.reserve(query.plus_term_ids.size() * (segments->size() + 1));
+    for (const int term_id : query.plus_term_ids) {
+        const double inverse_document_freq = word_to_document_freqs_.GetInverseDocumentFreq(term_id, document_count);
+        const double max_relevance = word_to_document_freqs_.GetMaxTermFreq(term_id) * inverse_document_freq;
+        const double max_relevance_per_count = word_to_document_freqs_.GetMaxInverseWordCount(term_id) * inverse_document_freq;
+        word_to_document_freqs_.ForEachPostingRun(term_id, *segments, [&](const PostingRun& postings) {
+            plus_postings.push_back({postings, inverse_document_freq, max_relevance, max_relevance_per_count});
+        });
+    }
+    std::vector<PostingRun> minus_postings;
+    for (const int term_id : query.minus_term_ids) {
+        word_to_document_freqs_.ForEachPostingRun(term_id, *segments, [&minus_postings](const PostingRun& postings) {
+            minus_postings.push_back(postings);
+        });
+    }
+
+    PROBE_RECORD("FindAllDocuments.runs", plus_postings.size());
+    const int ordinal_count = last_ordinal - first_ordinal;
+    size_t shard_count = 1;
+    if constexpr (!std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+        shard_count = std::max<size_t>(1, std::min<size_t>(parallel_shard_count_, ordinal_count));
+    }
+    // A status query skips blocks and, when pruned, runs of ordinals without documents of the status.
+    // Single documents are still checked with the predicate, which is cheaper than a bitmap test.
+    constexpr bool is_status_filter = std::is_same_v<DocumentPredicate, StatusFilter>;
+    const OrdinalBitmap* status_ordinals = nullptr;
+    if constexpr (is_status_filter) {
+        status_ordinals = &documents_.GetStatusOrdinals(document_predicate.status);
+    }
+    const auto accepts = [&](int ordinal) {
+        return documents_.IsAlive(ordinal)
+               && document_predicate(documents_.GetDocumentId(ordinal), documents_.GetStatus(ordinal), documents_.GetRating(ordinal));
+    };
+    // Shards look at the clock only if the query has a deadline, once per posting block
+    const bool has_deadline = query.deadline != std::chrono::steady_clock::time_point::max();
+    std::atomic_bool has_expired = false;
+    const auto is_expired = [&has_expired, has_deadline, &query] {
+        if (!has_deadline) {
+            return false;
+        }
+        if (!has_expired.load(std::memory_order_relaxed) && std::chrono::steady_clock::now() >= query.deadline) {
+            has_expired.store(true, std::memory_order_relaxed);
+        }
+        return has_expired.load(std::memory_order_relaxed);
+    };
+    const auto block_filter = [status_ordinals, &is_expired](int first_ordinal, int last_ordinal) {
+        return (!is_status_filter || status_ordinals->AnyInRange(first_ordinal, last_ordinal)) && !is_expired();
+    };
+    const bool is_pruned = retrieval_mode_ == RetrievalMode::PRUNED && max_result_count > 0
+                           && plus_postings.size() <= MAX_PRUNED_RUN_COUNT;
+    std::vector<std::vector<Document>> shard_documents(shard_count);
+    // Every shard owns a disjoint ordinal range, so shards never write to shared state
+    const auto score_shard = [&, range_first_ordinal = first_ordinal](size_t shard) {
+        const int first_ordinal = range_first_ordinal + static_cast<int>(ordinal_count * shard / shard_count);
+        const int last_ordinal = range_first_ordinal + static_cast<int>(ordinal_count * (shard + 1) / shard_count);
+        static thread_local RelevanceAccumulator accumulator;
+        static thread_local std::vector<int> excluded_buffer;
+        static thread_local std::vector<uint32_t> positions;
+        // Minus words are applied before accumulation, so excluded documents are never scored. Subtracting
+        // takes a vectorized pass over the excluded run per plus run, which pays off only for a few plus runs.
+        const auto [excluded_ordinals, excluded_count] = CollectOrdinals(minus_postings, first_ordinal, last_ordinal, excluded_buffer);
+        if (is_pruned) {
+            ScoreShardPruned(plus_postings, excluded_ordinals, excluded_count, first_ordinal, last_ordinal, accepts, status_ordinals, is_expired,
+                             max_result_count, shard_documents[shard]);
+            return;
+        }
+        accumulator.Reset(first_ordinal, last_ordinal);
+        const bool subtract_excluded = excluded_count > 0 && plus_postings.size() <= MAX_SUBTRACTED_RUN_COUNT;
+        if (!subtract_excluded) {
+            for (size_t i = 0; i < excluded_count; ++i) {
+                accumulator.Exclude(excluded_ordinals[i]);
+            }
+        }
+        for (const auto& [postings, inverse_document_freq, max_relevance, max_relevance_per_count] : plus_postings) {
+            if (is_expired()) {
+                break;
+            }
+            // Compressed runs are visited one decoded block at a time
+            ForEachPostingSlice(postings, first_ordinal, last_ordinal, block_filter, [&, inverse_document_freq = inverse_document_freq]
+                                (const int* ordinals, const uint32_t* term_counts, size_t size) {
+                const auto accumulate = [&](size_t i) {
+                    const int ordinal = ordinals[i];
+                    const auto state = accumulator.GetState(ordinal);
+                    if (state == RelevanceAccumulator::State::UNSEEN) {
+                        if (!accepts(ordinal)) {
+                            accumulator.Reject(ordinal);
+                            return;
+                        }
+                        accumulator.Accept(ordinal);
+                    } else if (state != RelevanceAccumulator::State::ACCEPTED) {
+                        return;
+                    }
+                    accumulator.Add(ordinal, documents_.GetTermFreq(ordinal, term_counts[i]) * inverse_document_freq);
+                };
+                if (!subtract_excluded) {
+                    for (size_t i = 0; i < size; ++i) {
+                        accumulate(i);
                     }
+                    return;
                 }
-        }});	
-    std::map<int, double> document_to_relevance = map_lock.BuildOrdinaryMap();
-    for (const std::string& word : query.minus_words) {
-        if (word_to_document_freqs_.count(word)) {
-            for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                document_to_relevance.erase(document_id);
-            }
+                // Only the excluded ordinals within the slice can match it
+                const int* first_excluded = std::lower_bound(excluded_ordinals, excluded_ordinals + excluded_count, ordinals[0]);
+                const int* last_excluded = std::upper_bound(first_excluded, excluded_ordinals + excluded_count, ordinals[size - 1]);
+                positions.resize(std::max(positions.size(), size));
+                const size_t kept_count = SubtractOrdinals(ordinals, size, first_excluded, last_excluded - first_excluded, positions.data());
+                for (size_t k = 0; k < kept_count; ++k) {
+                    accumulate(positions[k]);
+                }
+            });
         }
+        // Candidates are trimmed whenever the buffer fills up, so it never grows past trim_size
+        const size_t trim_size = 2 * max_result_count + 64;
+        auto& matched_documents = shard_documents[shard];
+        matched_documents.reserve(std::min(trim_size, accumulator.GetTouchedCount()));
+        accumulator.ForEachAccepted([&matched_documents, trim_size, max_result_count, this](int ordinal, double relevance) {
+            if (matched_documents.size() == trim_size) {
+                TrimTopDocuments(matched_documents, max_result_count);
+            }
+            matched_documents.push_back({documents_.GetDocumentId(ordinal), relevance, documents_.GetRating(ordinal)});
+        });
+        accumulator.Clear();
+        SelectTopDocuments(matched_documents, max_result_count);
+    };
+    if (shard_count == 1) {
+        score_shard(0);
+    } else {
+        std::vector<size_t> shards(shard_count);
+        std::iota(shards.begin(), shards.end(), 0);
+        std::for_each(policy, shards.begin(), shards.end(), score_shard);
+    }
+    // Thrown here rather than in a shard, which a parallel algorithm must not leave by an exception
+    if (has_expired) {
+        throw DeadlineExceededError();
+    }
+    if (shard_count == 1) {
+        return std::move(shard_documents[0]);
     }
     std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
-    }    
+    for (auto& documents : shard_documents) {
+        matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+    }
     return matched_documents;
 }
 
+template <typename OrdinalPredicate, typename ExpiryCheck>
+void SearchServer::ScoreShardPruned(const std::vector<ScoredRun>& runs, const int* excluded_ordinals, size_t excluded_count,
+                                    int first_ordinal, int last_ordinal, const OrdinalPredicate& accepts, const OrdinalBitmap* status_ordinals,
+                                    const ExpiryCheck& is_expired,
+                                    size_t max_result_count, std::vector<Document>& top_documents) const {
+    static thread_local std::vector<PostingCursor> cursors;
+    // Runs by ascending bound, and sums of the bounds of the first runs in that order
+    static thread_local std::vector<size_t> order;
+    static thread_local std::vector<double> bound_sums;
+    // Relevance a document gets from every run it is found in
+    static thread_local std::vector<std::pair<size_t, double>> parts;
+    cursors.clear();
+    for (const ScoredRun& run : runs) {
+        cursors.emplace_back(run.postings, first_ordinal, last_ordinal);
+    }
+    order.resize(runs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&runs](size_t lhs, size_t rhs) {
+        return runs[lhs].max_relevance < runs[rhs].max_relevance;
+    });
+    bound_sums.clear();
+    for (const size_t i : order) {
+        bound_sums.push_back((bound_sums.empty() ? 0.0 : bound_sums.back()) + runs[i].max_relevance);
+    }
+
+    const int* const excluded_end = excluded_ordinals + excluded_count;
+    // A document needs more relevance than this to enter the top documents. The margin covers
+    // the tolerance of IsMoreRelevant and rounding of the bounds.
+    double threshold = -std::numeric_limits<double>::infinity();
+    // Runs before it in the order cannot lift a document over the threshold on their own
+    size_t first_essential = 0;
+    for (size_t step = 0; first_essential < order.size(); ++step) {
+        if (step % 1024 == 0 && is_expired()) {
+            return;
+        }
+        int ordinal = PostingCursor::END;
+        for (size_t k = first_essential; k < order.size(); ++k) {
+            ordinal = std::min(ordinal, cursors[order[k]].GetOrdinal());
+        }
+        if (ordinal == PostingCursor::END) {
+            break;
+        }
+        if (status_ordinals != nullptr && !status_ordinals->Test(ordinal)) {
+            const int next_ordinal = status_ordinals->FindNext(ordinal);
+            for (size_t k = first_essential; k < order.size(); ++k) {
+                cursors[order[k]].SeekTo(next_ordinal < 0 ? PostingCursor::END : next_ordinal);
+            }
+            continue;
+        }
+        parts.clear();
+        double bound = first_essential > 0 ? bound_sums[first_essential - 1] : 0.0;
+        for (size_t k = first_essential; k < order.size(); ++k) {
+            PostingCursor& cursor = cursors[order[k]];
+            if (cursor.GetOrdinal() == ordinal) {
+                const double relevance = documents_.GetTermFreq(ordinal, cursor.GetTermCount()) * runs[order[k]].inverse_document_freq;
+                parts.push_back({order[k], relevance});
+                bound += relevance;
+                cursor.Next();
+            }
+        }
+        if (bound < threshold) {
+            continue;
+        }
+        while (excluded_ordinals != excluded_end && *excluded_ordinals < ordinal) {
+            ++excluded_ordinals;
+        }
+        if ((excluded_ordinals != excluded_end && *excluded_ordinals == ordinal) || !accepts(ordinal)) {
+            continue;
+        }
+        // Probes runs with the largest bounds first, as they tighten the bound the most
+        for (size_t k = first_essential; k > 0 && bound >= threshold; --k) {
+            const ScoredRun& run = runs[order[k - 1]];
+            PostingCursor& cursor = cursors[order[k - 1]];
+            const double block_bound = std::min(run.max_relevance, cursor.GetMaxTermCount(ordinal) * run.max_relevance_per_count);
+            bound += block_bound - run.max_relevance;
+            if (bound < threshold) {
+                break;
+            }
+            cursor.SeekTo(ordinal);
+            bound -= block_bound;
+            if (cursor.GetOrdinal() == ordinal) {
+                const double relevance = documents_.GetTermFreq(ordinal, cursor.GetTermCount()) * run.inverse_document_freq;
+                parts.push_back({order[k - 1], relevance});
+                bound += relevance;
+            }
+        }
+        if (bound < threshold) {
+            continue;
+        }
+        std::sort(parts.begin(), parts.end());
+        double relevance = 0.0;
+        for (const auto& [_, part] : parts) {
+            relevance += part;
+        }
+        const Document document{documents_.GetDocumentId(ordinal), relevance, documents_.GetRating(ordinal)};
+        if (top_documents.size() < max_result_count) {
+            top_documents.push_back(document);
+            std::push_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+        } else if (IsMoreRelevant(document, top_documents.front())) {
+            std::pop_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+            top_documents.back() = document;
+            std::push_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+        } else {
+            continue;
+        }
+        if (top_documents.size() == max_result_count) {
+            threshold = top_documents.front().relevance - 2 * RELEVANCE_EPSILON;
+            while (first_essential < order.size() && bound_sums[first_essential] < threshold) {
+                ++first_essential;
+            }
+        }
+    }
+}
+
 template<typename ExecutionPolicy>
 void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id){
-    if(!documents_.count(document_id)) return;
-    documents_.erase(document_id);
-    for(const auto [word_sv,_] : doc_id_to_words_freqs_[document_id]){
-        std::string word = static_cast<std::string>(word_sv);
-        word_to_document_freqs_[word].erase(document_id);
-        if(word_to_document_freqs_[word].empty()){
-            word_to_document_freqs_.erase(word);
+    RemoveDocuments(policy, std::initializer_list<int>{document_id});
+}
+
+template <typename ExecutionPolicy, typename IdRange>
+void SearchServer::RemoveDocuments(ExecutionPolicy&& policy, const IdRange& document_ids) {
+    std::vector<int> ordinals;
+    for (const int document_id : document_ids) {
+        const int ordinal = documents_.FindOrdinal(document_id);
+        if (ordinal >= 0) {
+            documents_.Remove(ordinal);
+            ordinals.push_back(ordinal);
+        }
+    }
+    if (ordinals.empty()) {
+        return;
+    }
+    ++index_generation_;
+
+    const std::vector<int> term_ids = CollectTermIds(ordinals);
+    std::vector<int> purged_ordinals;
+    for (const int ordinal : ordinals) {
+        if (word_to_document_freqs_.RetireDocument(ordinal, ordinal_to_term_freqs_[ordinal])) {
+            purged_ordinals.push_back(ordinal);
         }
     }
-    doc_id_to_words_freqs_.erase(document_id);
-    std::remove(policy, document_ids_.begin(), document_ids_.end(), document_id);
+    size_t shard_count = 1;
+    if constexpr (!std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+        shard_count = std::max<size_t>(1, std::min(parallel_shard_count_, term_ids.size()));
+    }
+    const auto purge_shard = [&](size_t shard) {
+        for (size_t i = term_ids.size() * shard / shard_count; i < term_ids.size() * (shard + 1) / shard_count; ++i) {
+            word_to_document_freqs_.RemoveBufferedPostingsIf(term_ids[i], [this](int ordinal) {
+                return !documents_.IsAlive(ordinal);
+            });
+        }
+    };
+    if (shard_count == 1) {
+        purge_shard(0);
+    } else {
+        std::vector<size_t> shards(shard_count);
+        std::iota(shards.begin(), shards.end(), 0);
+        std::for_each(policy, shards.begin(), shards.end(), purge_shard);
+    }
+    FinishRemoval(ordinals, purged_ordinals, term_ids);
 }
     
 template<typename ExecutionPolicy>
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(ExecutionPolicy&& policy, const std::string_view raw_query, int document_id) const {
-    const auto query = ParseQuery(static_cast<std::string>(raw_query));
+    const int ordinal = documents_.FindOrdinal(document_id);
+    if (ordinal < 0) {
+        throw std::out_of_range("Invalid document_id");
+    }
+    return {MatchOrdinal(policy, CompileMatchQuery(raw_query), ordinal), documents_.GetStatus(ordinal)};
+}
+
+template <typename ExecutionPolicy>
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                                                                                    const std::vector<int>& document_ids) const {
+    // Checked up front, as a parallel algorithm must not be left by an exception
+    std::vector<int> ordinals;
+    ordinals.reserve(document_ids.size());
+    for (const int document_id : document_ids) {
+        const int ordinal = documents_.FindOrdinal(document_id);
+        if (ordinal < 0) {
+            throw std::out_of_range("Invalid document_id");
+        }
+        ordinals.push_back(ordinal);
+    }
+    const CompiledQuery query = CompileMatchQuery(raw_query);
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> matches(ordinals.size());
+    std::transform(policy, ordinals.begin(), ordinals.end(), matches.begin(), [&query, this](int ordinal) {
+        return std::tuple{MatchOrdinal(std::execution::seq, query, ordinal), documents_.GetStatus(ordinal)};
+    });
+    return matches;
+}
+
+template <typename TermCallback>
+void SearchServer::ForEachMatchedTerm(const QueryTermIds& term_ids, const std::vector<std::pair<int, double>>& document_terms,
+                                      TermCallback on_match) {
+    const auto precedes = [](const std::pair<int, double>& term, int term_id) {
+        return term.first < term_id;
+    };
+    size_t position = 0;
+    for (size_t i = 0; i < term_ids.size() && position < document_terms.size(); ++i) {
+        // Terms before low precede the term id; high doubles its step until it reaches the id
+        size_t low = position;
+        size_t high = position;
+        for (size_t step = 1; high < document_terms.size() && document_terms[high].first < term_ids[i]; step *= 2) {
+            low = high + 1;
+            high = low + step;
+        }
+        position = std::lower_bound(document_terms.begin() + low, document_terms.begin() + std::min(high + 1, document_terms.size()),
+                                    term_ids[i], precedes)
+                   - document_terms.begin();
+        if (position < document_terms.size() && document_terms[position].first == term_ids[i]) {
+            on_match(i);
+            ++position;
+        }
+    }
+}
+
+template <typename ExecutionPolicy>
+std::vector<std::string_view> SearchServer::MatchOrdinal(ExecutionPolicy&& policy, const CompiledQuery& query, int ordinal) const {
+    // Postings of the document may be spread over segments, its forward entry is one sorted vector
+    const auto& document_terms = ordinal_to_term_freqs_[ordinal];
     std::vector<std::string_view> matched_words;
-    matched_words.reserve(query.plus_words.size());
-    std::mutex m;
-    std::for_each(policy, query.plus_words.begin(), query.plus_words.end(),
-        [&m,document_id, &raw_query, &matched_words, this](const std::string& word) {
-        if (word_to_document_freqs_.count(word)) {
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            std::lock_guard<std::mutex> guard(m);
-            matched_words.push_back(raw_query.substr(raw_query.find(word), word.size()));
-        }
-    }});    
-    for (const std::string& word : query.minus_words) {
-        if (word_to_document_freqs_.count(word)) {
-            if (word_to_document_freqs_.at(word).count(document_id)) {
-                matched_words.clear();
-                break;
+    bool has_minus_word = false;
+    ForEachMatchedTerm(query.minus_term_ids, document_terms, [&has_minus_word](size_t) {
+        has_minus_word = true;
+    });
+    if (has_minus_word) {
+        return matched_words;
+    }
+    if constexpr (!std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+        // Every term is looked up on its own, so the flags are written without a lock
+        std::vector<char> is_matched(query.plus_term_ids.size());
+        std::transform(policy, query.plus_term_ids.begin(), query.plus_term_ids.end(), is_matched.begin(), [&document_terms](int term_id) {
+            const auto it = std::lower_bound(document_terms.begin(), document_terms.end(), term_id, [](const auto& term, int id) {
+                return term.first < id;
+            });
+            return it != document_terms.end() && it->first == term_id;
+        });
+        for (size_t i = 0; i < is_matched.size(); ++i) {
+            if (is_matched[i]) {
+                matched_words.push_back(word_to_document_freqs_.GetTerm(query.plus_term_ids[i]));
             }
         }
+    } else {
+        ForEachMatchedTerm(query.plus_term_ids, document_terms, [&matched_words, &query, this](size_t i) {
+            matched_words.push_back(word_to_document_freqs_.GetTerm(query.plus_term_ids[i]));
+        });
     }
-    return { matched_words, documents_.at(document_id).status };
+    std::sort(matched_words.begin(), matched_words.end());
+    return matched_words;
 }
     
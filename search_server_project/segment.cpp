@@ -0,0 +1,265 @@
+#include "segment.h"
+#include "snapshot_io.h"
+
+#include <climits>
+#include <cstring>
+#include <utility>
+
+using namespace std;
+
+namespace {
+uint8_t GetBitWidth(uint32_t value) {
+    return value == 0 ? 0 : static_cast<uint8_t>(32 - __builtin_clz(value));
+}
+
+// Appends values of the given width to the data, least significant bits first
+void PackBits(const uint32_t* values, size_t count, uint8_t width, vector<uint32_t>& data) {
+    uint64_t buffer = 0;
+    int buffered_bits = 0;
+    for (size_t i = 0; i < count; ++i) {
+        buffer |= static_cast<uint64_t>(values[i]) << buffered_bits;
+        buffered_bits += width;
+        if (buffered_bits >= 32) {
+            data.push_back(static_cast<uint32_t>(buffer));
+            buffer >>= 32;
+            buffered_bits -= 32;
+        }
+    }
+    if (buffered_bits > 0) {
+        data.push_back(static_cast<uint32_t>(buffer));
+    }
+}
+
+// Calls store(i, value) for count values of the given width packed from the data.
+// Reads 64 bits starting at the word of each value, so values of width above zero must be
+// followed by a padding word; values of width zero occupy no words and nothing is read.
+// Returns the word after the last one read.
+template <typename Store>
+const uint32_t* UnpackBits(const uint32_t* data, size_t count, uint8_t width, Store store) {
+    if (width == 0) {
+        for (size_t i = 0; i < count; ++i) {
+            store(i, 0);
+        }
+        return data;
+    }
+    const uint64_t mask = (uint64_t{1} << width) - 1;
+    size_t bit = 0;
+    for (size_t i = 0; i < count; ++i, bit += width) {
+        uint64_t word;
+        memcpy(&word, data + bit / 32, sizeof(word));
+        store(i, static_cast<uint32_t>((word >> (bit % 32)) & mask));
+    }
+    return data + (bit + 31) / 32;
+}
+}
+
+PostingRun Segment::FindPostings(int term_id) const {
+    const int* it = lower_bound(term_ids_, term_ids_ + term_count_, term_id);
+    if (it == term_ids_ + term_count_ || *it != term_id) {
+        return {};
+    }
+    return GetPostings(it - term_ids_);
+}
+
+bool Segment::HasTerm(int term_id) const {
+    return binary_search(term_ids_, term_ids_ + term_count_, term_id);
+}
+
+size_t Segment::DecodeBlock(size_t index, int* ordinals, uint32_t* term_counts) const {
+    const PostingBlock& block = blocks_[index];
+    int ordinal = block.first_ordinal;
+    ordinals[0] = ordinal;
+    const uint32_t* data = UnpackBits(data_ + block.data_offset, block.size - 1u, block.gap_bits, [&](size_t i, uint32_t gap) {
+        ordinal += static_cast<int>(gap) + 1;
+        ordinals[i + 1] = ordinal;
+    });
+    UnpackBits(data, block.size, block.term_count_bits, [term_counts](size_t i, uint32_t term_count) {
+        term_counts[i] = term_count + 1;
+    });
+    return block.size;
+}
+
+size_t Segment::GetByteCount() const {
+    return term_count_ * (sizeof(int) + sizeof(uint64_t)) + block_count_ * sizeof(PostingBlock) + data_size_ * sizeof(uint32_t);
+}
+
+void Segment::WriteSnapshot(SnapshotWriter& writer) const {
+    writer.Write<uint64_t>(term_count_);
+    writer.Write<uint64_t>(block_count_);
+    writer.Write<uint64_t>(data_size_);
+    writer.Write<uint64_t>(posting_count_);
+    writer.WriteArray(term_ids_, term_count_);
+    writer.WriteArray(term_block_offsets_, term_count_ + 1);
+    writer.WriteArray(blocks_, block_count_);
+    writer.WriteArray(data_, data_size_);
+}
+
+shared_ptr<const Segment> Segment::ReadSnapshot(SnapshotReader& reader, int term_id_count, int ordinal_count) {
+    shared_ptr<Segment> segment(new Segment());
+    segment->term_count_ = reader.Read<uint64_t>();
+    segment->block_count_ = reader.Read<uint64_t>();
+    segment->data_size_ = reader.Read<uint64_t>();
+    segment->posting_count_ = reader.Read<uint64_t>();
+    segment->term_ids_ = reader.ReadArray<int>(segment->term_count_);
+    segment->term_block_offsets_ = reader.ReadArray<uint64_t>(segment->term_count_ + 1);
+    segment->blocks_ = reader.ReadArray<PostingBlock>(segment->block_count_);
+    segment->data_ = reader.ReadArray<uint32_t>(segment->data_size_);
+
+    const int* term_ids = segment->term_ids_;
+    const uint64_t* term_block_offsets = segment->term_block_offsets_;
+    CheckSnapshot(term_block_offsets[0] == 0 && term_block_offsets[segment->term_count_] == segment->block_count_);
+    for (size_t i = 0; i < segment->term_count_; ++i) {
+        CheckSnapshot(term_ids[i] >= 0 && term_ids[i] < term_id_count && (i == 0 || term_ids[i - 1] < term_ids[i]));
+        CheckSnapshot(term_block_offsets[i] <= term_block_offsets[i + 1]);
+    }
+    size_t posting_count = 0;
+    for (size_t i = 0; i < segment->block_count_; ++i) {
+        CheckSnapshot(segment->IsValidBlock(i, ordinal_count));
+        posting_count += segment->blocks_[i].size;
+    }
+    CheckSnapshot(posting_count == segment->posting_count_);
+    return segment;
+}
+
+bool Segment::IsValidBlock(size_t index, int ordinal_count) const {
+    const PostingBlock& block = blocks_[index];
+    if (block.size == 0 || block.size > POSTING_BLOCK_SIZE || block.gap_bits > 32 || block.term_count_bits > 32
+        || block.first_ordinal < 0 || block.last_ordinal >= ordinal_count) {
+        return false;
+    }
+    const size_t word_count = ((block.size - 1u) * block.gap_bits + 31) / 32 + (block.size * block.term_count_bits + 31) / 32;
+    // UnpackBits also reads the word after the last one holding a value
+    if (word_count > 0 && block.data_offset + word_count + 1 > data_size_) {
+        return false;
+    }
+    // Gaps are not negative, so the ordinals rise from first_ordinal and end at last_ordinal
+    int64_t ordinal = block.first_ordinal;
+    UnpackBits(data_ + block.data_offset, block.size - 1u, block.gap_bits, [&ordinal](size_t, uint32_t gap) {
+        ordinal += int64_t{gap} + 1;
+    });
+    return ordinal == block.last_ordinal;
+}
+
+void Segment::Builder::AddTerm(int term_id, const int* ordinals, const uint32_t* term_counts, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    uint32_t values[POSTING_BLOCK_SIZE];
+    for (size_t first = 0; first < size; first += POSTING_BLOCK_SIZE) {
+        const size_t block_size = min(POSTING_BLOCK_SIZE, size - first);
+        PostingBlock block{};
+        block.first_ordinal = ordinals[first];
+        block.last_ordinal = ordinals[first + block_size - 1];
+        block.data_offset = static_cast<uint32_t>(data_.size());
+        block.size = static_cast<uint8_t>(block_size);
+
+        uint32_t max_value = 0;
+        for (size_t i = 1; i < block_size; ++i) {
+            values[i - 1] = static_cast<uint32_t>(ordinals[first + i] - ordinals[first + i - 1] - 1);
+            max_value |= values[i - 1];
+        }
+        block.gap_bits = GetBitWidth(max_value);
+        PackBits(values, block_size - 1, block.gap_bits, data_);
+
+        max_value = 0;
+        uint32_t max_term_count = 0;
+        for (size_t i = 0; i < block_size; ++i) {
+            values[i] = term_counts[first + i] - 1;
+            max_value |= values[i];
+            max_term_count = max(max_term_count, term_counts[first + i]);
+        }
+        block.term_count_bits = GetBitWidth(max_value);
+        block.max_term_count = static_cast<uint8_t>(min<uint32_t>(max_term_count, MAX_BLOCK_TERM_COUNT));
+        PackBits(values, block_size, block.term_count_bits, data_);
+        blocks_.push_back(block);
+    }
+    term_ids_.push_back(term_id);
+    term_block_offsets_.push_back(blocks_.size());
+    posting_count_ += size;
+}
+
+shared_ptr<const Segment> Segment::Builder::Build() {
+    if (posting_count_ == 0) {
+        return nullptr;
+    }
+    shared_ptr<Segment> segment(new Segment());
+    segment->owned_term_ids_ = move(term_ids_);
+    segment->owned_term_block_offsets_ = move(term_block_offsets_);
+    segment->owned_blocks_ = move(blocks_);
+    segment->owned_data_ = move(data_);
+    // Padding for UnpackBits: the last packed value may end in the last word, which is then read
+    // together with the word after it
+    segment->owned_data_.push_back(0);
+    segment->owned_blocks_.shrink_to_fit();
+    segment->owned_data_.shrink_to_fit();
+    segment->term_ids_ = segment->owned_term_ids_.data();
+    segment->term_block_offsets_ = segment->owned_term_block_offsets_.data();
+    segment->blocks_ = segment->owned_blocks_.data();
+    segment->data_ = segment->owned_data_.data();
+    segment->term_count_ = segment->owned_term_ids_.size();
+    segment->block_count_ = segment->owned_blocks_.size();
+    segment->data_size_ = segment->owned_data_.size();
+    segment->posting_count_ = posting_count_;
+    return segment;
+}
+
+shared_ptr<const Segment> MergeSegments(const SegmentList& segments, const vector<int>& removed_ordinals,
+                                        vector<int>& purged_ordinals) {
+    // 1 for a removed ordinal, 2 once its postings were met
+    vector<char> removed(removed_ordinals.empty() ? 0 : removed_ordinals.back() + 1);
+    for (const int ordinal : removed_ordinals) {
+        removed[ordinal] = 1;
+    }
+    Segment::Builder builder;
+    vector<size_t> cursors(segments.size());
+    vector<pair<int, uint32_t>> postings;
+    vector<int> ordinals;
+    vector<uint32_t> term_counts;
+    int block_ordinals[POSTING_BLOCK_SIZE];
+    uint32_t block_term_counts[POSTING_BLOCK_SIZE];
+    while (true) {
+        int term_id = INT_MAX;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            if (cursors[i] < segments[i]->GetTermCount()) {
+                term_id = min(term_id, segments[i]->GetTermId(cursors[i]));
+            }
+        }
+        if (term_id == INT_MAX) {
+            break;
+        }
+        postings.clear();
+        bool is_sorted = true;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            if (cursors[i] == segments[i]->GetTermCount() || segments[i]->GetTermId(cursors[i]) != term_id) {
+                continue;
+            }
+            const PostingRun run = segments[i]->GetPostings(cursors[i]++);
+            for (size_t block = run.first_block; block < run.last_block; ++block) {
+                const size_t size = segments[i]->DecodeBlock(block, block_ordinals, block_term_counts);
+                for (size_t j = 0; j < size; ++j) {
+                    const int ordinal = block_ordinals[j];
+                    if (ordinal < static_cast<int>(removed.size()) && removed[ordinal] != 0) {
+                        if (removed[ordinal] == 1) {
+                            removed[ordinal] = 2;
+                            purged_ordinals.push_back(ordinal);
+                        }
+                        continue;
+                    }
+                    is_sorted = is_sorted && (postings.empty() || postings.back().first < ordinal);
+                    postings.emplace_back(ordinal, block_term_counts[j]);
+                }
+            }
+        }
+        // Released ordinals are reused, so a newer segment may hold smaller ordinals
+        if (!is_sorted) {
+            sort(postings.begin(), postings.end());
+        }
+        ordinals.resize(postings.size());
+        term_counts.resize(postings.size());
+        for (size_t j = 0; j < postings.size(); ++j) {
+            tie(ordinals[j], term_counts[j]) = postings[j];
+        }
+        builder.AddTerm(term_id, ordinals.data(), term_counts.data(), ordinals.size());
+    }
+    return builder.Build();
+}
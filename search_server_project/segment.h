@@ -0,0 +1,199 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class SnapshotReader;
+class SnapshotWriter;
+
+class Segment;
+
+// Postings of one term: either a plain run of ordinals in ascending order with their term
+// counts, or a range of compressed blocks of a segment
+struct PostingRun {
+    const int* ordinals = nullptr;
+    const uint32_t* term_counts = nullptr;
+    size_t size = 0;
+    const Segment* segment = nullptr;
+    size_t first_block = 0;
+    size_t last_block = 0;
+
+    bool empty() const {
+        return size == 0 && first_block == last_block;
+    }
+};
+
+// Skip data and layout of POSTING_BLOCK_SIZE postings: ordinals are stored as gaps, term counts
+// as count - 1, both bit-packed with the widths of their largest values. The largest term count
+// bounds the relevance of the block's documents; it saturates at MAX_BLOCK_TERM_COUNT.
+struct PostingBlock {
+    int first_ordinal;
+    int last_ordinal;
+    uint32_t data_offset;
+    uint8_t size;
+    uint8_t gap_bits;
+    uint8_t term_count_bits;
+    uint8_t max_term_count;
+};
+
+constexpr uint8_t MAX_BLOCK_TERM_COUNT = 255;
+
+constexpr size_t POSTING_BLOCK_SIZE = 128;
+
+// Immutable compressed postings of many terms: term ids in ascending order and, for every
+// term, a contiguous range of blocks. Segments never change once built, so index copies
+// and concurrent queries share them.
+class Segment {
+public:
+    class Builder;
+
+    Segment(const Segment&) = delete;
+
+    Segment& operator=(const Segment&) = delete;
+
+    // Empty run if the segment has no postings of the term
+    PostingRun FindPostings(int term_id) const;
+
+    bool HasTerm(int term_id) const;
+
+    size_t GetTermCount() const {
+        return term_count_;
+    }
+
+    int GetTermId(size_t index) const {
+        return term_ids_[index];
+    }
+
+    PostingRun GetPostings(size_t index) const {
+        PostingRun run;
+        run.segment = this;
+        run.first_block = term_block_offsets_[index];
+        run.last_block = term_block_offsets_[index + 1];
+        return run;
+    }
+
+    const PostingBlock& GetBlock(size_t index) const {
+        return blocks_[index];
+    }
+
+    // Writes ordinals and term counts of the block, returns their number
+    size_t DecodeBlock(size_t index, int* ordinals, uint32_t* term_counts) const;
+
+    size_t GetPostingCount() const {
+        return posting_count_;
+    }
+
+    // Bytes of the compressed postings and their skip data
+    size_t GetByteCount() const;
+
+    void WriteSnapshot(SnapshotWriter& writer) const;
+
+    // Arrays are borrowed from the reader's buffer, which must outlive the segment. Every block
+    // is decoded once to check that it stays within the data and holds ordinals below
+    // ordinal_count, and term ids are checked against term_id_count.
+    static std::shared_ptr<const Segment> ReadSnapshot(SnapshotReader& reader, int term_id_count, int ordinal_count);
+
+private:
+    Segment() = default;
+
+    bool IsValidBlock(size_t index, int ordinal_count) const;
+
+    std::vector<int> owned_term_ids_;
+    std::vector<uint64_t> owned_term_block_offsets_;
+    std::vector<PostingBlock> owned_blocks_;
+    std::vector<uint32_t> owned_data_;
+    const int* term_ids_ = nullptr;
+    const uint64_t* term_block_offsets_ = nullptr;
+    const PostingBlock* blocks_ = nullptr;
+    const uint32_t* data_ = nullptr;
+    size_t term_count_ = 0;
+    size_t block_count_ = 0;
+    size_t data_size_ = 0;
+    size_t posting_count_ = 0;
+};
+
+// Terms must be added in ascending order of ids
+class Segment::Builder {
+public:
+    void AddTerm(int term_id, const int* ordinals, const uint32_t* term_counts, size_t size);
+
+    // Returns nullptr if no posting was added
+    std::shared_ptr<const Segment> Build();
+
+private:
+    std::vector<int> term_ids_;
+    std::vector<uint64_t> term_block_offsets_{0};
+    std::vector<PostingBlock> blocks_;
+    std::vector<uint32_t> data_;
+    size_t posting_count_ = 0;
+};
+
+using SegmentList = std::vector<std::shared_ptr<const Segment>>;
+
+// Calls visitor(ordinals, term_counts, size) for consecutive slices of the run holding its
+// postings with ordinals in [first_ordinal, last_ordinal). Compressed blocks outside the range
+// are skipped by their skip data, the others are decoded one at a time into scratch arrays
+// of the thread, so the visitor must not walk another run.
+template <typename Visitor>
+void ForEachPostingSlice(const PostingRun& run, int first_ordinal, int last_ordinal, Visitor visitor);
+
+// Same, but a compressed block is not decoded unless block_filter(first, last) is true for
+// the range of ordinals [first, last] it may hold within the range
+template <typename BlockFilter, typename Visitor>
+void ForEachPostingSlice(const PostingRun& run, int first_ordinal, int last_ordinal, BlockFilter block_filter, Visitor visitor);
+
+// Combines the postings of the segments into one segment, dropping postings of removed
+// ordinals (sorted). Removed ordinals which had postings in the segments are appended to
+// purged_ordinals. Returns nullptr if no posting is left.
+std::shared_ptr<const Segment> MergeSegments(const SegmentList& segments, const std::vector<int>& removed_ordinals,
+                                             std::vector<int>& purged_ordinals);
+
+template <typename Visitor>
+void ForEachPostingSlice(const PostingRun& run, int first_ordinal, int last_ordinal, Visitor visitor) {
+    ForEachPostingSlice(run, first_ordinal, last_ordinal, [](int, int) {
+        return true;
+    }, visitor);
+}
+
+template <typename BlockFilter, typename Visitor>
+void ForEachPostingSlice(const PostingRun& run, int first_ordinal, int last_ordinal, BlockFilter block_filter, Visitor visitor) {
+    if (run.segment == nullptr) {
+        const int* first = std::lower_bound(run.ordinals, run.ordinals + run.size, first_ordinal);
+        const int* last = std::lower_bound(first, run.ordinals + run.size, last_ordinal);
+        if (first != last) {
+            visitor(first, run.term_counts + (first - run.ordinals), static_cast<size_t>(last - first));
+        }
+        return;
+    }
+    static thread_local int ordinals[POSTING_BLOCK_SIZE];
+    static thread_local uint32_t term_counts[POSTING_BLOCK_SIZE];
+    size_t low = run.first_block;
+    size_t high = run.last_block;
+    while (low < high) {
+        const size_t middle = (low + high) / 2;
+        if (run.segment->GetBlock(middle).last_ordinal < first_ordinal) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    for (size_t block = low; block < run.last_block && run.segment->GetBlock(block).first_ordinal < last_ordinal; ++block) {
+        const PostingBlock& skip_data = run.segment->GetBlock(block);
+        if (!block_filter(std::max(first_ordinal, skip_data.first_ordinal), std::min(last_ordinal - 1, skip_data.last_ordinal))) {
+            continue;
+        }
+        const size_t size = run.segment->DecodeBlock(block, ordinals, term_counts);
+        if (first_ordinal <= skip_data.first_ordinal && skip_data.last_ordinal < last_ordinal) {
+            visitor(static_cast<const int*>(ordinals), static_cast<const uint32_t*>(term_counts), size);
+            continue;
+        }
+        const int* end = ordinals + size;
+        const int* first = std::lower_bound(static_cast<const int*>(ordinals), end, first_ordinal);
+        const int* last = std::lower_bound(first, end, last_ordinal);
+        if (first != last) {
+            visitor(first, term_counts + (first - ordinals), static_cast<size_t>(last - first));
+        }
+    }
+}
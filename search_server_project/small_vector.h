@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <type_traits>
+
+// Vector of trivially copyable values which keeps up to N of them inline and allocates only
+// past that. clear() keeps an allocated buffer, so a reused vector stops allocating.
+// Iterators are pointers.
+template <typename T, size_t N>
+class SmallVector {
+    static_assert(std::is_trivially_copyable_v<T>, "SmallVector holds trivially copyable values");
+
+public:
+    SmallVector() = default;
+
+    SmallVector(std::initializer_list<T> values);
+
+    SmallVector(const SmallVector& other);
+
+    SmallVector(SmallVector&& other) noexcept;
+
+    SmallVector& operator=(const SmallVector& other);
+
+    SmallVector& operator=(SmallVector&& other) noexcept;
+
+    T* begin() {
+        return data_;
+    }
+
+    T* end() {
+        return data_ + size_;
+    }
+
+    const T* begin() const {
+        return data_;
+    }
+
+    const T* end() const {
+        return data_ + size_;
+    }
+
+    T* data() {
+        return data_;
+    }
+
+    const T* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    size_t capacity() const {
+        return capacity_;
+    }
+
+    T& operator[](size_t index) {
+        return data_[index];
+    }
+
+    const T& operator[](size_t index) const {
+        return data_[index];
+    }
+
+    T& back() {
+        return data_[size_ - 1];
+    }
+
+    const T& back() const {
+        return data_[size_ - 1];
+    }
+
+    void push_back(const T& value) {
+        if (size_ == capacity_) {
+            // The value may be one of ours, which reserve frees
+            const T copy = value;
+            reserve(2 * capacity_);
+            data_[size_++] = copy;
+            return;
+        }
+        data_[size_++] = value;
+    }
+
+    void reserve(size_t capacity);
+
+    // New values are value-initialized
+    void resize(size_t size);
+
+    void clear() {
+        size_ = 0;
+    }
+
+private:
+    T inline_values_[N];
+    std::unique_ptr<T[]> heap_values_;
+    T* data_ = inline_values_;
+    size_t size_ = 0;
+    size_t capacity_ = N;
+};
+
+template <typename T, size_t N>
+bool operator==(const SmallVector<T, N>& lhs, const SmallVector<T, N>& rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+}
+
+template <typename T, size_t N>
+bool operator!=(const SmallVector<T, N>& lhs, const SmallVector<T, N>& rhs) {
+    return !(lhs == rhs);
+}
+
+template <typename T, size_t N>
+SmallVector<T, N>::SmallVector(std::initializer_list<T> values) {
+    reserve(values.size());
+    std::copy(values.begin(), values.end(), data_);
+    size_ = values.size();
+}
+
+template <typename T, size_t N>
+SmallVector<T, N>::SmallVector(const SmallVector& other) {
+    reserve(other.size_);
+    std::copy(other.begin(), other.end(), data_);
+    size_ = other.size_;
+}
+
+template <typename T, size_t N>
+SmallVector<T, N>::SmallVector(SmallVector&& other) noexcept {
+    *this = std::move(other);
+}
+
+template <typename T, size_t N>
+SmallVector<T, N>& SmallVector<T, N>::operator=(const SmallVector& other) {
+    if (this != &other) {
+        size_ = 0;
+        reserve(other.size_);
+        std::copy(other.begin(), other.end(), data_);
+        size_ = other.size_;
+    }
+    return *this;
+}
+
+template <typename T, size_t N>
+SmallVector<T, N>& SmallVector<T, N>::operator=(SmallVector&& other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+    if (other.heap_values_) {
+        heap_values_ = std::move(other.heap_values_);
+        data_ = heap_values_.get();
+        capacity_ = other.capacity_;
+    } else {
+        // Inline values are copied, while a buffer of this vector big enough is kept
+        if (capacity_ < other.size_) {
+            heap_values_.reset();
+            data_ = inline_values_;
+            capacity_ = N;
+        }
+        std::copy(other.begin(), other.end(), data_);
+    }
+    size_ = other.size_;
+    other.data_ = other.inline_values_;
+    other.size_ = 0;
+    other.capacity_ = N;
+    return *this;
+}
+
+template <typename T, size_t N>
+void SmallVector<T, N>::reserve(size_t capacity) {
+    if (capacity <= capacity_) {
+        return;
+    }
+    std::unique_ptr<T[]> values(new T[capacity]);
+    std::copy(begin(), end(), values.get());
+    heap_values_ = std::move(values);
+    data_ = heap_values_.get();
+    capacity_ = capacity;
+}
+
+template <typename T, size_t N>
+void SmallVector<T, N>::resize(size_t size) {
+    reserve(size);
+    std::fill(data_ + std::min(size, size_), data_ + size, T());
+    size_ = size;
+}
@@ -0,0 +1,69 @@
+#include "snapshot_io.h"
+
+#include <algorithm>
+#include <cstdio>
+
+using namespace std;
+
+namespace {
+const size_t SNAPSHOT_ALIGNMENT = 8;
+}
+
+void CheckSnapshot(bool is_valid) {
+    if (!is_valid) {
+        throw runtime_error("Snapshot is corrupt"s);
+    }
+}
+
+SnapshotWriter::SnapshotWriter(const string& path)
+    : path_(path)
+    , temporary_path_(path + ".tmp"s)
+    , output_(temporary_path_, ios::binary | ios::trunc) {
+    if (!output_) {
+        throw runtime_error("Cannot open snapshot file "s + temporary_path_);
+    }
+}
+
+void SnapshotWriter::WriteBytes(string_view bytes) {
+    WriteRaw(bytes.data(), bytes.size());
+}
+
+void SnapshotWriter::Finish() {
+    output_.close();
+    if (!output_) {
+        remove(temporary_path_.c_str());
+        throw runtime_error("Cannot write snapshot file "s + temporary_path_);
+    }
+    if (rename(temporary_path_.c_str(), path_.c_str()) != 0) {
+        remove(temporary_path_.c_str());
+        throw runtime_error("Cannot replace snapshot file "s + path_);
+    }
+}
+
+void SnapshotWriter::Align() {
+    static const char padding[SNAPSHOT_ALIGNMENT] = {};
+    WriteRaw(padding, (SNAPSHOT_ALIGNMENT - offset_ % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT);
+}
+
+void SnapshotWriter::WriteRaw(const void* data, size_t size) {
+    output_.write(static_cast<const char*>(data), static_cast<streamsize>(size));
+    offset_ += size;
+}
+
+SnapshotReader::SnapshotReader(const char* data, size_t size)
+    : data_(data)
+    , size_(size) {
+}
+
+string_view SnapshotReader::ReadBytes(size_t size) {
+    if (size > size_ - offset_) {
+        throw runtime_error("Snapshot is truncated"s);
+    }
+    const string_view bytes(data_ + offset_, size);
+    offset_ += size;
+    return bytes;
+}
+
+void SnapshotReader::Align() {
+    offset_ = min(size_, (offset_ + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT);
+}
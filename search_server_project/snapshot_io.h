@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Sequential binary encoding of an index snapshot. Values are stored in native byte order;
+// every array starts at an offset aligned to 8 bytes, so a reader over a mapped file
+// hands out pointers into the mapping instead of copying.
+// The writer fills a temporary file and renames it over the target in Finish, so a server
+// still mapping the previous snapshot at the same path keeps reading intact data.
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path);
+
+    template <typename T>
+    void Write(T value) {
+        WriteArray(&value, 1);
+    }
+
+    template <typename T>
+    void WriteArray(const T* values, size_t count) {
+        Align();
+        WriteRaw(values, count * sizeof(T));
+    }
+
+    // Not aligned: used for runs of term bytes
+    void WriteBytes(std::string_view bytes);
+
+    // Pads the output to the start of the next array
+    void Align();
+
+    // Throws std::runtime_error if any write failed or the file cannot be renamed
+    void Finish();
+
+private:
+    void WriteRaw(const void* data, size_t size);
+
+    std::string path_;
+    std::string temporary_path_;
+    std::ofstream output_;
+    size_t offset_ = 0;
+};
+
+// Throws std::runtime_error unless is_valid. Loaded values which serve as ids, offsets or
+// enums are checked with it against what was read before, so a corrupt file fails to load
+// instead of sending queries out of bounds.
+void CheckSnapshot(bool is_valid);
+
+// Throws std::runtime_error when the data ends before the requested value
+class SnapshotReader {
+public:
+    SnapshotReader(const char* data, size_t size);
+
+    template <typename T>
+    T Read() {
+        return *ReadArray<T>(1);
+    }
+
+    template <typename T>
+    const T* ReadArray(size_t count) {
+        Align();
+        if (count > (size_ - offset_) / sizeof(T)) {
+            throw std::runtime_error("Snapshot is truncated");
+        }
+        const T* values = reinterpret_cast<const T*>(data_ + offset_);
+        offset_ += count * sizeof(T);
+        return values;
+    }
+
+    std::string_view ReadBytes(size_t size);
+
+private:
+    void Align();
+
+    const char* data_;
+    size_t size_;
+    size_t offset_ = 0;
+};
@@ -2,19 +2,17 @@
 
 
 
-std::vector<std::string> SplitIntoWords(const std::string& text) {
-    std::vector<std::string> words;
-    size_t word_start = 0;
+std::vector<std::string_view> SplitIntoWords(std::string_view text) {
+    std::vector<std::string_view> words;
+    size_t word_count = 0;
     for (size_t i = 0; i != text.size(); ++i) {
-        if (text[i] == ' ') {
-            if (word_start != i) {
-                words.push_back(std::string{ &text[word_start], i - word_start });
-            }
-            word_start = i + 1;
+        if (text[i] != ' ' && (i == 0 || text[i - 1] == ' ')) {
+            ++word_count;
         }
     }
-    if (word_start != text.size()) {
-        words.push_back(std::string{ &text[word_start], text.size() - word_start });
-    }
+    words.reserve(word_count);
+    ForEachWord(text, [&words](std::string_view word) {
+        words.push_back(word);
+    });
     return words;
 }
@@ -6,13 +6,31 @@
 #include <set>
 
 
-std::vector<std::string> SplitIntoWords(const std::string& text);
+// Returned views point into text
+std::vector<std::string_view> SplitIntoWords(std::string_view text);
+
+// Calls callback(word) for every word of text, in order and without allocating
+template <typename Callback>
+void ForEachWord(std::string_view text, Callback callback) {
+    size_t word_start = 0;
+    for (size_t i = 0; i != text.size(); ++i) {
+        if (text[i] == ' ') {
+            if (word_start != i) {
+                callback(text.substr(word_start, i - word_start));
+            }
+            word_start = i + 1;
+        }
+    }
+    if (word_start != text.size()) {
+        callback(text.substr(word_start));
+    }
+}
 
 template <typename StringContainer>
-std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
-    std::set<std::string> non_empty_strings;
-    for (const std::string& str : strings) {
-        if (!str.empty()) {
+std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
+    std::set<std::string, std::less<>> non_empty_strings;
+    for (const auto& str : strings) {
+        if (!std::string_view(str).empty()) {
             non_empty_strings.emplace(str);
         }
     }
@@ -0,0 +1,177 @@
+#include "term_pool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <utility>
+
+using namespace std;
+
+TermPool::TermPool(const TermPool& other)
+    : blocks_(other.blocks_)
+    , allocated_bytes_(other.allocated_bytes_)
+    , terms_(other.terms_)
+    , slots_(other.slots_)
+    , term_count_(other.term_count_)
+    , free_ids_(other.free_ids_) {
+}
+
+TermPool::TermPool(TermPool&& other) noexcept
+    : blocks_(move(other.blocks_))
+    , block_free_(exchange(other.block_free_, nullptr))
+    , block_free_size_(exchange(other.block_free_size_, 0))
+    , allocated_bytes_(exchange(other.allocated_bytes_, 0))
+    , terms_(move(other.terms_))
+    , slots_(move(other.slots_))
+    , term_count_(exchange(other.term_count_, 0))
+    , free_ids_(move(other.free_ids_)) {
+}
+
+TermPool& TermPool::operator=(TermPool other) noexcept {
+    swap(blocks_, other.blocks_);
+    swap(block_free_, other.block_free_);
+    swap(block_free_size_, other.block_free_size_);
+    swap(allocated_bytes_, other.allocated_bytes_);
+    swap(terms_, other.terms_);
+    swap(slots_, other.slots_);
+    swap(term_count_, other.term_count_);
+    swap(free_ids_, other.free_ids_);
+    return *this;
+}
+
+int TermPool::Intern(string_view term) {
+    if (2 * (term_count_ + 1) > slots_.size()) {
+        Rehash(max<size_t>(16, 2 * slots_.size()));
+    }
+    const size_t slot = FindSlot(term);
+    if (slots_[slot] != EMPTY_SLOT) {
+        return slots_[slot];
+    }
+    char* data = Allocate(term.size());
+    memcpy(data, term.data(), term.size());
+    const string_view stored_term(data, term.size());
+    int term_id;
+    if (!free_ids_.empty()) {
+        term_id = free_ids_.back();
+        free_ids_.pop_back();
+        terms_[term_id] = stored_term;
+    } else {
+        term_id = static_cast<int>(terms_.size());
+        terms_.push_back(stored_term);
+    }
+    slots_[slot] = term_id;
+    ++term_count_;
+    return term_id;
+}
+
+int TermPool::Find(string_view term) const {
+    if (slots_.empty()) {
+        return -1;
+    }
+    return slots_[FindSlot(term)];
+}
+
+void TermPool::Release(int term_id) {
+    // Backward shift deletion keeps every probe sequence free of holes
+    const size_t mask = slots_.size() - 1;
+    size_t hole = FindSlot(terms_[term_id]);
+    for (size_t slot = (hole + 1) & mask; slots_[slot] != EMPTY_SLOT; slot = (slot + 1) & mask) {
+        const size_t home = GetHomeSlot(terms_[slots_[slot]]);
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            slots_[hole] = slots_[slot];
+            hole = slot;
+        }
+    }
+    slots_[hole] = EMPTY_SLOT;
+    terms_[term_id] = {};
+    free_ids_.push_back(term_id);
+    --term_count_;
+}
+
+void TermPool::Compact() {
+    vector<shared_ptr<char[]>> old_blocks = move(blocks_);
+    block_free_ = nullptr;
+    block_free_size_ = 0;
+    allocated_bytes_ = 0;
+    for (string_view& term : terms_) {
+        if (term.empty()) {
+            continue;
+        }
+        char* data = Allocate(term.size());
+        memcpy(data, term.data(), term.size());
+        term = string_view(data, term.size());
+    }
+}
+
+void TermPool::Adopt(const vector<string_view>& terms) {
+    blocks_.clear();
+    block_free_ = nullptr;
+    block_free_size_ = 0;
+    allocated_bytes_ = 0;
+    terms_ = terms;
+    free_ids_.clear();
+    term_count_ = 0;
+    for (size_t term_id = terms_.size(); term_id > 0; --term_id) {
+        if (terms_[term_id - 1].empty()) {
+            free_ids_.push_back(static_cast<int>(term_id - 1));
+        } else {
+            ++term_count_;
+        }
+    }
+    size_t slot_count = 16;
+    while (2 * term_count_ > slot_count) {
+        slot_count *= 2;
+    }
+    Rehash(slot_count);
+}
+
+size_t TermPool::GetTermCount() const {
+    return term_count_;
+}
+
+int TermPool::GetIdCount() const {
+    return static_cast<int>(terms_.size());
+}
+
+size_t TermPool::GetAllocatedBytes() const {
+    return allocated_bytes_ + terms_.capacity() * sizeof(string_view) + slots_.capacity() * sizeof(int);
+}
+
+char* TermPool::Allocate(size_t size) {
+    if (size > block_free_size_) {
+        const size_t block_size = max(size, BLOCK_SIZE);
+        blocks_.emplace_back(new char[block_size], default_delete<char[]>());
+        allocated_bytes_ += block_size;
+        if (block_size > BLOCK_SIZE) {
+            return blocks_.back().get();
+        }
+        block_free_ = blocks_.back().get();
+        block_free_size_ = block_size;
+    }
+    char* data = block_free_;
+    block_free_ += size;
+    block_free_size_ -= size;
+    return data;
+}
+
+size_t TermPool::FindSlot(string_view term) const {
+    const size_t mask = slots_.size() - 1;
+    size_t slot = GetHomeSlot(term);
+    while (slots_[slot] != EMPTY_SLOT && terms_[slots_[slot]] != term) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+size_t TermPool::GetHomeSlot(string_view term) const {
+    return hash<string_view>{}(term) & (slots_.size() - 1);
+}
+
+void TermPool::Rehash(size_t slot_count) {
+    slots_.assign(slot_count, EMPTY_SLOT);
+    for (size_t term_id = 0; term_id < terms_.size(); ++term_id) {
+        if (!terms_[term_id].empty()) {
+            slots_[FindSlot(terms_[term_id])] = static_cast<int>(term_id);
+        }
+    }
+}
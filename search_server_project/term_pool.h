@@ -0,0 +1,69 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Append-only arena owning the bytes of every indexed term. Each distinct term gets
+// a small integer id which never changes while the term is in the pool; views returned
+// by GetTerm stay valid until Compact, which rewrites live terms into fresh blocks.
+// Written bytes are never modified, so copies share blocks and only append to new ones.
+// Lookup goes through an open-addressing table of ids, which costs a few bytes per term
+// instead of a hash node per term.
+class TermPool {
+public:
+    TermPool() = default;
+
+    TermPool(const TermPool& other);
+
+    TermPool(TermPool&& other) noexcept;
+
+    TermPool& operator=(TermPool other) noexcept;
+
+    int Intern(std::string_view term);
+
+    // Returns -1 if the term is not in the pool
+    int Find(std::string_view term) const;
+
+    std::string_view GetTerm(int term_id) const {
+        return terms_[term_id];
+    }
+
+    // The id may be handed out again by Intern; its bytes are reclaimed by Compact
+    void Release(int term_id);
+
+    void Compact();
+
+    // Replaces the contents with the given terms indexed by id, without copying their bytes:
+    // the caller keeps them alive until Compact. Empty terms stand for released ids.
+    void Adopt(const std::vector<std::string_view>& terms);
+
+    size_t GetTermCount() const;
+
+    // Upper bound of term ids, including released ones
+    int GetIdCount() const;
+
+    size_t GetAllocatedBytes() const;
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    static constexpr int EMPTY_SLOT = -1;
+
+    char* Allocate(size_t size);
+
+    // Returns the slot holding the term or the empty slot where it would be inserted
+    size_t FindSlot(std::string_view term) const;
+
+    size_t GetHomeSlot(std::string_view term) const;
+
+    void Rehash(size_t slot_count);
+
+    std::vector<std::shared_ptr<char[]>> blocks_;
+    char* block_free_ = nullptr;
+    size_t block_free_size_ = 0;
+    size_t allocated_bytes_ = 0;
+    std::vector<std::string_view> terms_;
+    std::vector<int> slots_;
+    size_t term_count_ = 0;
+    std::vector<int> free_ids_;
+};
@@ -1,5 +1,28 @@
 #include "test_example_functions.h"
 #include "search_server.h"
+#include "async_request_queue.h"
+#include "concurrent_search_server.h"
+#include "ingest_documents.h"
+#include "instrumentation.h"
+#include "latency_histogram.h"
+#include "ordinal_set_ops.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "request_queue.h"
+#include "segment.h"
+#include "small_vector.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
+
 using namespace std;
 
 #define ASSERT_EQUAL(a, b) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, ""s)
@@ -43,6 +66,11 @@ void TestExcludeStopWordsFromAddedDocumentContent() {
     SearchServer server("in the"s);
     server.AddDocument(doc_id, content, DocumentStatus::ACTUAL, ratings);
     ASSERT_HINT(server.FindTopDocuments("in"s).empty(), "Stop words must be excluded.");
+    {
+        SearchServer view_server("in the"sv);
+        view_server.AddDocument(doc_id, content, DocumentStatus::ACTUAL, ratings);
+        ASSERT_HINT(view_server.FindTopDocuments("in"s).empty(), "Stop words given as string_view must be excluded.");
+    }
 }
 
 void TestMinusWords() {
@@ -120,6 +148,13 @@ void TestRelevanceCalc() {
     const double TF_2 = 1 * 0.5;
     ASSERT_EQUAL_HINT(result[0].relevance, IDF * TF_2, "Wrong relevance calculation.");
     ASSERT_EQUAL_HINT(result[1].relevance, IDF * TF_0, "Wrong relevance calculation.");
+
+    search_server.AddDocument(3, "fluffy dog"s, DocumentStatus::ACTUAL, {1});
+    result = search_server.FindTopDocuments("cat"s);
+    ASSERT_EQUAL_HINT(result[0].relevance, log(4 * 0.5) * TF_2, "IDF is not updated after adding a document.");
+    search_server.RemoveDocument(0);
+    result = search_server.FindTopDocuments("cat"s);
+    ASSERT_EQUAL_HINT(result[0].relevance, log(3 * 1.0) * TF_2, "IDF is not updated after removing a document.");
 }
 
 void TestRelevanceSort() {
@@ -132,6 +167,992 @@ void TestRelevanceSort() {
     ASSERT_EQUAL_HINT(result[1].id, 0, "Relevance sort does not work.");
 }
 
+void TestResultCount() {
+    SearchServer search_server;
+    for (int id = 0; id < 20; ++id) {
+        search_server.AddDocument(id, "cat number "s + to_string(id), DocumentStatus::ACTUAL, {id});
+    }
+    ASSERT_EQUAL_HINT(search_server.FindTopDocuments("cat"s).size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT),
+                      "Default result count is wrong.");
+    const auto found_docs = search_server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, 12);
+    ASSERT_EQUAL_HINT(found_docs.size(), 12u, "Requested result count is ignored.");
+    for (size_t i = 0; i < found_docs.size(); ++i) {
+        ASSERT_EQUAL_HINT(found_docs[i].id, 19 - static_cast<int>(i), "Equal relevance must be ordered by rating.");
+    }
+    const auto par_docs = search_server.FindTopDocuments(execution::par, "cat"s, DocumentStatus::ACTUAL, 12);
+    ASSERT_EQUAL_HINT(par_docs.size(), 12u, "Requested result count is ignored by parallel search.");
+    ASSERT_EQUAL_HINT(par_docs[11].id, 8, "Parallel search returns different documents.");
+}
+
+void TestRemoveDocument() {
+    SearchServer search_server;
+    search_server.AddDocument(0, "cat in the city"s, DocumentStatus::ACTUAL, {8, -3});
+    search_server.AddDocument(1, "dog in the park"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.RemoveDocument(0);
+    ASSERT_EQUAL_HINT(search_server.GetDocumentCount(), 1, "Removed document is still counted.");
+    ASSERT_HINT(search_server.FindTopDocuments("cat"s).empty(), "Removed document is still found.");
+    ASSERT_HINT(search_server.GetWordFrequencies(0).empty(), "Removed document still has words.");
+    search_server.AddDocument(5, "smooth cat"s, DocumentStatus::ACTUAL, {5, -12, 2, 1});
+    const auto found_docs = search_server.FindTopDocuments("cat"s);
+    ASSERT_EQUAL_HINT(found_docs.size(), 1u, "Document added after removal is not found.");
+    ASSERT_EQUAL_HINT(found_docs[0].id, 5, "Document added after removal has wrong id.");
+    ASSERT_EQUAL_HINT(found_docs[0].rating, -1, "Document added after removal has wrong rating.");
+}
+
+void TestRemoveDocuments() {
+    SearchServer search_server;
+    search_server.AddDocument(0, "cat in the city"s, DocumentStatus::ACTUAL, {8, -3});
+    search_server.AddDocument(1, "dog in the park"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "smooth cat"s, DocumentStatus::ACTUAL, {5, -12, 2, 1});
+    search_server.AddDocument(3, "fluffy dog"s, DocumentStatus::ACTUAL, {1});
+    search_server.RemoveDocuments(execution::par, vector<int>{0, 3, 42, 0});
+    ASSERT_EQUAL_HINT(search_server.GetDocumentCount(), 2, "Removed documents are still counted.");
+    ASSERT_HINT(vector<int>(search_server.begin(), search_server.end()) == vector<int>({1, 2}), "Removed ids are still iterated.");
+    ASSERT_EQUAL_HINT(search_server.FindTopDocuments("cat"s).size(), 1u, "Removed document is still found.");
+    ASSERT_EQUAL_HINT(search_server.FindTopDocuments("fluffy dog"s).size(), 1u, "Removed document is still found.");
+    search_server.CompactIndex();
+    search_server.AddDocument(4, "fluffy cat"s, DocumentStatus::ACTUAL, {2});
+    ASSERT_EQUAL_HINT(search_server.FindTopDocuments("fluffy"s).size(), 1u, "Removed words come back after compaction.");
+    ASSERT_EQUAL_HINT(search_server.FindTopDocuments("cat"s).size(), 2u, "Document added after removal is not found.");
+}
+
+void TestRemoveDuplicates() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    search_server.AddDocument(3, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    search_server.AddDocument(4, "funny pet and curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    search_server.AddDocument(5, "funny funny pet and nasty nasty rat"s, DocumentStatus::ACTUAL, {1, 2});
+    search_server.AddDocument(6, "funny pet and not very nasty rat"s, DocumentStatus::ACTUAL, {1, 2});
+    search_server.AddDocument(7, "very nasty rat and not very funny pet"s, DocumentStatus::ACTUAL, {1, 2});
+    search_server.AddDocument(8, "pet with rat and rat and rat"s, DocumentStatus::ACTUAL, {1, 2});
+    search_server.AddDocument(9, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+    const auto removed_ids = RemoveDuplicates(search_server);
+    ASSERT_HINT(removed_ids == vector<int>({3, 4, 5, 7}), "Documents with the same words must be removed, keeping the lowest id.");
+    ASSERT_EQUAL_HINT(search_server.GetDocumentCount(), 5, "Duplicates are not removed from the server.");
+
+    SearchServer near_server;
+    string text;
+    for (int i = 0; i < 20; ++i) {
+        text += " word"s + to_string(i);
+    }
+    near_server.AddDocument(10, text, DocumentStatus::ACTUAL, {1});
+    near_server.AddDocument(11, text + " extra"s, DocumentStatus::ACTUAL, {1});
+    near_server.AddDocument(12, "something else entirely"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_HINT(RemoveDuplicates(near_server).empty(), "Documents with different words are not duplicates.");
+    ASSERT_HINT(RemoveDuplicates(near_server, 0.9) == vector<int>({11}), "Near-duplicates must be removed.");
+}
+
+void TestQueryCache() {
+    SearchServer search_server("and in the"s);
+    search_server.AddDocument(0, "cat in the city"s, DocumentStatus::ACTUAL, {8, -3});
+    search_server.AddDocument(1, "dog in the park"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    RequestQueue request_queue(search_server);
+    const auto first_result = request_queue.AddFindRequest("cat dog"s);
+    ASSERT_EQUAL_HINT(request_queue.GetCacheStats().miss_count, 1u, "First request must miss the cache.");
+    for (const string& query : {"dog cat"s, "cat and dog dog"s, "cat dog elephant"s}) {
+        const auto result = request_queue.AddFindRequest(query);
+        ASSERT_EQUAL_HINT(result.size(), first_result.size(), "Cached result differs.");
+        ASSERT_EQUAL_HINT(result[0].id, first_result[0].id, "Cached result differs.");
+    }
+    ASSERT_EQUAL_HINT(request_queue.GetCacheStats().hit_count, 3u, "Equivalent queries must hit the cache.");
+    request_queue.AddFindRequest("cat dog"s, DocumentStatus::BANNED);
+    ASSERT_EQUAL_HINT(request_queue.GetCacheStats().miss_count, 2u, "Status must be a part of the cache key.");
+    ASSERT_EQUAL_HINT(request_queue.GetNoResultRequests(), 1, "Cached requests break empty result counting.");
+
+    search_server.AddDocument(2, "smooth cat"s, DocumentStatus::ACTUAL, {5});
+    ASSERT_EQUAL_HINT(request_queue.AddFindRequest("cat dog"s).size(), 3u, "Cache must be invalidated by a new document.");
+    search_server.RemoveDocument(0);
+    ASSERT_EQUAL_HINT(request_queue.AddFindRequest("cat dog"s).size(), 2u, "Cache must be invalidated by a removed document.");
+    ASSERT_EQUAL_HINT(request_queue.GetCacheStats().miss_count, 4u, "Stale results must not be hits.");
+
+    QueryCache cache(1000);
+    cache.Insert("a"s, 1, vector<Document>(10));
+    cache.Insert("b"s, 1, vector<Document>(10));
+    cache.Find("a"s, 1);
+    cache.Insert("c"s, 1, vector<Document>(5));
+    ASSERT_HINT(cache.GetByteCount() <= 1000u, "Cache exceeds its byte budget.");
+    ASSERT_HINT(cache.Find("a"s, 1) != nullptr && cache.Find("b"s, 1) == nullptr, "Least recently used result must go first.");
+    cache.Insert("d"s, 1, vector<Document>(1000));
+    ASSERT_HINT(cache.Find("d"s, 1) == nullptr, "Result over the whole budget must not be kept.");
+}
+
+void TestConcurrentSearchServer() {
+    ConcurrentSearchServer search_server{SearchServer()};
+    const int document_count = 300;
+    const int window = 5;
+    atomic_bool is_writing = true;
+    thread writer([&] {
+        for (int id = 0; id < document_count; ++id) {
+            search_server.AddDocument(id, "common word"s + to_string(id), DocumentStatus::ACTUAL, {id});
+            if (id >= window) {
+                search_server.RemoveDocuments({id - window});
+            }
+        }
+        is_writing = false;
+    });
+    vector<thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&] {
+            do {
+                // Every snapshot holds the documents of a window which existed between two writes
+                const auto snapshot = search_server.GetSnapshot();
+                const auto found_docs = snapshot->FindTopDocuments("common"s, [](int, DocumentStatus, int) { return true; }, 1000);
+                ASSERT_EQUAL_HINT(static_cast<int>(found_docs.size()), snapshot->GetDocumentCount(), "Snapshot changed during a query.");
+                ASSERT_HINT(found_docs.size() <= window + 1, "Snapshot shows a removed document.");
+                if (!found_docs.empty()) {
+                    const auto [min_doc, max_doc] = minmax_element(found_docs.begin(), found_docs.end(), [](const Document& lhs, const Document& rhs) {
+                        return lhs.id < rhs.id;
+                    });
+                    ASSERT_EQUAL_HINT(max_doc->id - min_doc->id + 1, static_cast<int>(found_docs.size()), "Snapshot shows a partial write.");
+                }
+            } while (is_writing);
+        });
+    }
+    writer.join();
+    for (thread& reader : readers) {
+        reader.join();
+    }
+    ASSERT_EQUAL_HINT(search_server.GetSnapshot()->GetDocumentCount(), window, "Writes are lost.");
+    ASSERT_EQUAL_HINT(search_server.FindTopDocuments("word"s + to_string(document_count - 1)).size(), 1u, "Writes are lost.");
+    try {
+        search_server.AddDocument(document_count - 1, "duplicate"s, DocumentStatus::ACTUAL, {});
+        ASSERT_HINT(false, "Duplicate id must be rejected.");
+    } catch (const invalid_argument&) {
+    }
+    search_server.AddDocument(document_count, "common"s, DocumentStatus::ACTUAL, {});
+    ASSERT_EQUAL_HINT(search_server.GetSnapshot()->GetDocumentCount(), window + 1, "Failed write breaks the standby copy.");
+
+    // A writer outlasting its spin sleeps until the snapshot of the old copy is released
+    auto held_snapshot = search_server.GetSnapshot();
+    atomic_bool is_written = false;
+    thread blocked_writer([&] {
+        search_server.AddDocument(document_count + 1, "common"s, DocumentStatus::ACTUAL, {});
+        is_written = true;
+    });
+    this_thread::sleep_for(chrono::milliseconds(50));
+    ASSERT_HINT(!is_written, "Writer must wait for the snapshot of the old copy.");
+    ASSERT_EQUAL_HINT(held_snapshot->GetDocumentCount(), window + 1, "Held snapshot changed.");
+    held_snapshot.reset();
+    blocked_writer.join();
+    ASSERT_EQUAL_HINT(search_server.GetSnapshot()->GetDocumentCount(), window + 2, "Released snapshot must let the writer finish.");
+}
+
+void TestCompactIndex() {
+    SearchServer search_server;
+    search_server.AddDocument(0, "cat in the city"s, DocumentStatus::ACTUAL, {8, -3});
+    search_server.AddDocument(1, "dog in the park"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "smooth cat"s, DocumentStatus::ACTUAL, {5, -12, 2, 1});
+    search_server.RemoveDocument(1);
+    search_server.CompactIndex();
+    search_server.AddDocument(3, "fluffy dog"s, DocumentStatus::ACTUAL, {1});
+    const auto found_docs = search_server.FindTopDocuments("cat dog"s);
+    ASSERT_EQUAL_HINT(found_docs.size(), 3u, "Compaction loses indexed terms.");
+    const auto word_freqs = search_server.GetWordFrequencies(0);
+    ASSERT_EQUAL_HINT(word_freqs.size(), 4u, "Compaction loses document words.");
+    ASSERT_EQUAL_HINT(static_cast<string>(word_freqs.begin()->first), "cat"s, "Compaction corrupts document words.");
+    const auto [words, status] = search_server.MatchDocument("fluffy park"s, 3);
+    ASSERT_EQUAL_HINT(words.size(), 1u, "Compaction breaks matching.");
+}
+
+void TestAddDocuments() {
+    const vector<RawDocument> documents = {
+        {0, "cat in the city"s, DocumentStatus::ACTUAL, {8, -3}},
+        {1, "dog in the park"s, DocumentStatus::ACTUAL, {7, 2, 7}},
+        {2, "smooth cat"s, DocumentStatus::BANNED, {5, -12, 2, 1}},
+    };
+    SearchServer search_server("in the"s);
+    search_server.AddDocuments(execution::par, documents);
+    ASSERT_EQUAL_HINT(search_server.GetDocumentCount(), 3, "Batch documents are not added.");
+    const auto found_docs = search_server.FindTopDocuments("cat"s);
+    ASSERT_EQUAL_HINT(found_docs.size(), 1u, "Batch documents lose their status.");
+    ASSERT_EQUAL_HINT(found_docs[0].rating, 2, "Batch documents lose their rating.");
+
+    const vector<RawDocument> duplicates = {{3, "fluffy dog"s, DocumentStatus::ACTUAL, {}}, {3, "fluffy cat"s, DocumentStatus::ACTUAL, {}}};
+    try {
+        search_server.AddDocuments(duplicates);
+        ASSERT_HINT(false, "Duplicate ids in a batch must be rejected.");
+    } catch (const invalid_argument&) {
+    }
+    const vector<RawDocument> invalid = {{4, "fluffy dog"s, DocumentStatus::ACTUAL, {}}, {5, "fluffy c\x12t"s, DocumentStatus::ACTUAL, {}}};
+    try {
+        search_server.AddDocuments(execution::par, invalid);
+        ASSERT_HINT(false, "Invalid words in a batch must be rejected.");
+    } catch (const invalid_argument&) {
+    }
+    ASSERT_EQUAL_HINT(search_server.GetDocumentCount(), 3, "Rejected batch must not add documents.");
+    ASSERT_HINT(search_server.FindTopDocuments("fluffy"s).empty(), "Rejected batch must not add words.");
+}
+
+// Unique file in the temporary directory, so a test that aborts leaves nothing in the working one
+string MakeTemporaryPath() {
+    string path = (filesystem::temp_directory_path() / "search_server_test_XXXXXX").string();
+    const int descriptor = mkstemp(path.data());
+    ASSERT_HINT(descriptor >= 0, "Temporary file must be created.");
+    close(descriptor);
+    return path;
+}
+
+void TestIndexSnapshot() {
+    const string path = MakeTemporaryPath();
+    SearchServer search_server("in the"s);
+    search_server.AddDocument(0, "cat in the city"s, DocumentStatus::ACTUAL, {8, -3});
+    search_server.AddDocument(1, "dog in the park"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "smooth cat smooth tail"s, DocumentStatus::BANNED, {5, -12, 2, 1});
+    search_server.AddDocument(3, "fluffy dog"s, DocumentStatus::ACTUAL, {1});
+    search_server.RemoveDocument(1);
+    search_server.SaveIndex(path);
+
+    SearchServer loaded_server = SearchServer::LoadIndex(path);
+    ASSERT_EQUAL_HINT(loaded_server.GetDocumentCount(), search_server.GetDocumentCount(), "Loaded index has other documents.");
+    ASSERT_HINT(loaded_server.GetStopWords() == search_server.GetStopWords(), "Loaded index has other stop words.");
+    for (const string& query : {"cat dog"s, "smooth -city"s, "fluffy park cat"s}) {
+        for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+            const auto expected = search_server.FindTopDocuments(query, status);
+            const auto found = loaded_server.FindTopDocuments(execution::par, query, status);
+            ASSERT_EQUAL_HINT(found.size(), expected.size(), "Loaded index finds other documents.");
+            for (size_t i = 0; i < found.size(); ++i) {
+                ASSERT_EQUAL_HINT(found[i].id, expected[i].id, "Loaded index finds other documents.");
+                ASSERT_HINT(abs(found[i].relevance - expected[i].relevance) < 1e-6, "Loaded index computes other relevance.");
+                ASSERT_EQUAL_HINT(found[i].rating, expected[i].rating, "Loaded index has other ratings.");
+            }
+        }
+    }
+    ASSERT_HINT(loaded_server.GetWordFrequencies(2) == search_server.GetWordFrequencies(2), "Loaded index has other word frequencies.");
+    const auto [words, status] = loaded_server.MatchDocument("smooth tail dog"s, 2);
+    ASSERT_EQUAL_HINT(words.size(), 2u, "Loaded index breaks matching.");
+    ASSERT_HINT(status == DocumentStatus::BANNED, "Loaded index loses document status.");
+
+    // Mapped postings are copied on the first change
+    loaded_server.AddDocument(4, "cat and dog"s, DocumentStatus::ACTUAL, {3});
+    loaded_server.RemoveDocument(0);
+    ASSERT_EQUAL_HINT(loaded_server.FindTopDocuments("cat"s).size(), 1u, "Loaded index is not updatable.");
+    ASSERT_EQUAL_HINT(loaded_server.FindTopDocuments("dog"s).size(), 2u, "Loaded index is not updatable.");
+    ASSERT_EQUAL_HINT(search_server.FindTopDocuments("cat"s).size(), 1u, "Updating loaded index changes the original.");
+
+    {
+        ofstream output(path, ios::binary | ios::trunc);
+        output << "not a snapshot"s;
+    }
+    try {
+        SearchServer::LoadIndex(path);
+        ASSERT_HINT(false, "Invalid snapshot must be rejected.");
+    } catch (const runtime_error&) {
+    }
+
+    // Every byte of a valid snapshot overwritten in turn: the load either throws or gives an
+    // index which queries stay within
+    search_server.SaveIndex(path);
+    string snapshot;
+    {
+        ifstream input(path, ios::binary);
+        snapshot.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+    }
+    size_t rejected_count = 0;
+    for (size_t i = 0; i < snapshot.size(); ++i) {
+        for (const char value : {'\x01', '\x7f', '\xff'}) {
+            string corrupt_snapshot = snapshot;
+            corrupt_snapshot[i] ^= value;
+            {
+                ofstream output(path, ios::binary | ios::trunc);
+                output << corrupt_snapshot;
+            }
+            try {
+                const SearchServer corrupt_server = SearchServer::LoadIndex(path);
+                for (const string& query : {"cat dog"s, "smooth -city"s, "fluffy park cat"s}) {
+                    corrupt_server.FindTopDocuments(query, DocumentStatus::BANNED);
+                    corrupt_server.FindTopDocuments(execution::par, query);
+                    for (int index = 0; index < corrupt_server.GetDocumentCount(); ++index) {
+                        corrupt_server.MatchDocument(query, corrupt_server.GetDocumentId(index));
+                    }
+                }
+            } catch (const runtime_error&) {
+                ++rejected_count;
+            }
+        }
+    }
+    ASSERT_HINT(rejected_count > 0, "Corrupt snapshots must be rejected.");
+    remove(path.c_str());
+}
+
+void TestIngestDocuments() {
+    {
+        SearchServer search_server("in the"s);
+        istringstream input(
+            "{\"id\": 0, \"text\": \"cat in the city\", \"status\": \"ACTUAL\", \"ratings\": [8, -3]}\n"
+            "\n"
+            "{\"ratings\": [], \"id\": 1, \"source\": {\"name\": \"x\", \"tags\": [1, null]}, \"text\": \"dog \\\"in\\\" the park\", \"status\": 2}\r\n"
+            "{\"id\": 2, \"text\": \"\\u0441\\u043e\\u0431\\u0430\\u043a\\u0430 dog\"}"s);
+        const IngestStats stats = IngestDocuments(search_server, input, 2, 1);
+        ASSERT_EQUAL_HINT(stats.document_count, 3u, "Not all lines are ingested.");
+        ASSERT_EQUAL_HINT(search_server.GetDocumentCount(), 3, "Not all lines are ingested.");
+        ASSERT_EQUAL_HINT(search_server.FindTopDocuments("cat"s)[0].rating, 2, "Ratings are not parsed.");
+        ASSERT_EQUAL_HINT(search_server.FindTopDocuments("\"in\""s, DocumentStatus::BANNED).size(), 1u, "Escapes or status are not parsed.");
+        ASSERT_EQUAL_HINT(search_server.FindTopDocuments("собака"s).size(), 1u, "Unicode escapes are not parsed.");
+    }
+    {
+        SearchServer search_server;
+        istringstream input("{\"id\": 0, \"text\": \"cat\"}\n{\"id\": 1, \"text\": \"dog}\n"s);
+        try {
+            IngestDocuments(search_server, input);
+            ASSERT_HINT(false, "Malformed line must be rejected.");
+        } catch (const invalid_argument& e) {
+            ASSERT_HINT(string(e.what()).find("Line 2"s) != string::npos, "Error must name the malformed line.");
+        }
+    }
+}
+
+void TestIndexSegments() {
+    SearchServer segmented_server("in the"s);
+    SearchServer buffered_server("in the"s);
+    segmented_server.SetIndexBufferLimit(4);
+    for (int id = 0; id < 40; ++id) {
+        const string text = "cat"s + to_string(id % 7) + " in the city"s + to_string(id % 3) + (id % 2 == 0 ? " dog"s : ""s);
+        segmented_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 5});
+        buffered_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 5});
+    }
+    ASSERT_HINT(segmented_server.GetIndexSegmentCount() > 0, "Full buffer must be frozen into a segment.");
+    segmented_server.RemoveDocuments(execution::par, vector<int>{0, 2, 5, 39});
+    buffered_server.RemoveDocuments(execution::par, vector<int>{0, 2, 5, 39});
+    for (const string& query : {"cat1 dog"s, "city2 -dog"s, "cat0 cat5 city1"s}) {
+        const auto expected = buffered_server.FindTopDocuments(query);
+        const auto result = segmented_server.FindTopDocuments(execution::par, query);
+        ASSERT_EQUAL_HINT(result.size(), expected.size(), "Segments change search results.");
+        for (size_t i = 0; i < result.size(); ++i) {
+            ASSERT_EQUAL_HINT(result[i].id, expected[i].id, "Segments change search results.");
+            ASSERT_HINT(abs(result[i].relevance - expected[i].relevance) < 1e-6, "Segments change relevance.");
+        }
+    }
+    segmented_server.CompactIndex();
+    ASSERT_EQUAL_HINT(segmented_server.GetIndexSegmentCount(), 1u, "Compaction must merge all segments.");
+    segmented_server.AddDocument(100, "cat1 dog"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL_HINT(segmented_server.FindTopDocuments("cat1"s, DocumentStatus::ACTUAL, 10).size(), 7u, "Document added after compaction is not found.");
+    ASSERT_EQUAL_HINT(get<0>(segmented_server.MatchDocument("cat1 city1 dog"s, 100)).size(), 2u, "Words of a segmented document are not matched.");
+}
+
+void TestOrdinalSetOps() {
+    mt19937 generator(42);
+    for (int round = 0; round < 200; ++round) {
+        vector<int> a;
+        vector<int> b;
+        const int range = 1 + round * 5;
+        for (int ordinal = 0; ordinal < range; ++ordinal) {
+            if (generator() % 3 == 0) {
+                a.push_back(ordinal);
+            }
+            if (generator() % (1 + round % 4) == 0) {
+                b.push_back(ordinal);
+            }
+        }
+        vector<uint32_t> expected_common;
+        vector<uint32_t> expected_rest;
+        for (size_t i = 0; i < a.size(); ++i) {
+            (binary_search(b.begin(), b.end(), a[i]) ? expected_common : expected_rest).push_back(static_cast<uint32_t>(i));
+        }
+        for (const OrdinalKernel kernel : {OrdinalKernel::SCALAR, OrdinalKernel::SSE2, OrdinalKernel::AVX2}) {
+            if (!IsOrdinalKernelSupported(kernel)) {
+                continue;
+            }
+            vector<uint32_t> positions(a.size());
+            positions.resize(IntersectOrdinals(a.data(), a.size(), b.data(), b.size(), positions.data(), kernel));
+            ASSERT_HINT(positions == expected_common, "Intersection kernel is wrong.");
+            positions.resize(a.size());
+            positions.resize(SubtractOrdinals(a.data(), a.size(), b.data(), b.size(), positions.data(), kernel));
+            ASSERT_HINT(positions == expected_rest, "Difference kernel is wrong.");
+        }
+    }
+}
+
+void TestCompressedPostings() {
+    mt19937 generator(7);
+    Segment::Builder builder;
+    vector<vector<int>> term_ordinals(50);
+    vector<vector<uint32_t>> term_counts(50);
+    for (size_t term_id = 0; term_id < term_ordinals.size(); term_id += 1 + term_id % 3) {
+        const int max_gap = term_id % 4 == 0 ? 1 : 1 << (term_id % 20);
+        for (int ordinal = static_cast<int>(generator() % 10); ordinal >= 0 && ordinal < 5'000'000; ordinal += 1 + static_cast<int>(generator() % max_gap)) {
+            term_ordinals[term_id].push_back(ordinal);
+            term_counts[term_id].push_back(term_id % 5 == 0 ? 1 : 1 + generator() % (1u << (term_id % 17)));
+            if (term_ordinals[term_id].size() == 1000 + term_id * 10) {
+                break;
+            }
+        }
+        builder.AddTerm(static_cast<int>(term_id), term_ordinals[term_id].data(), term_counts[term_id].data(), term_ordinals[term_id].size());
+    }
+    const auto segment = builder.Build();
+    ASSERT_HINT(segment != nullptr, "Segment with postings must be built.");
+    size_t raw_byte_count = 0;
+    for (size_t term_id = 0; term_id < term_ordinals.size(); ++term_id) {
+        const vector<int>& ordinals = term_ordinals[term_id];
+        raw_byte_count += ordinals.size() * (sizeof(int) + sizeof(uint32_t));
+        const PostingRun run = segment->FindPostings(static_cast<int>(term_id));
+        ASSERT_EQUAL_HINT(run.empty(), ordinals.empty(), "Segment finds postings of a missing term.");
+        if (ordinals.empty()) {
+            continue;
+        }
+        for (int round = 0; round < 5; ++round) {
+            int first_ordinal = ordinals[generator() % ordinals.size()];
+            int last_ordinal = round == 0 ? numeric_limits<int>::max() : ordinals[generator() % ordinals.size()] + 1;
+            if (round == 0) {
+                first_ordinal = 0;
+            } else if (first_ordinal > last_ordinal) {
+                swap(first_ordinal, last_ordinal);
+            }
+            const auto first = lower_bound(ordinals.begin(), ordinals.end(), first_ordinal);
+            const auto last = lower_bound(first, ordinals.end(), last_ordinal);
+            vector<int> decoded_ordinals;
+            vector<uint32_t> decoded_counts;
+            ForEachPostingSlice(run, first_ordinal, last_ordinal, [&](const int* slice_ordinals, const uint32_t* slice_counts, size_t size) {
+                decoded_ordinals.insert(decoded_ordinals.end(), slice_ordinals, slice_ordinals + size);
+                decoded_counts.insert(decoded_counts.end(), slice_counts, slice_counts + size);
+            });
+            ASSERT_HINT(decoded_ordinals == vector<int>(first, last), "Decoded ordinals differ from encoded ones.");
+            const auto counts_first = term_counts[term_id].begin() + (first - ordinals.begin());
+            ASSERT_HINT(decoded_counts == vector<uint32_t>(counts_first, counts_first + (last - first)), "Decoded term counts differ from encoded ones.");
+        }
+    }
+    ASSERT_HINT(segment->GetByteCount() < raw_byte_count / 2, "Postings are not compressed.");
+
+    vector<int> removed_ordinals = {term_ordinals[1][3], term_ordinals[1][500]};
+    sort(removed_ordinals.begin(), removed_ordinals.end());
+    vector<int> purged_ordinals;
+    const auto merged = MergeSegments({segment}, removed_ordinals, purged_ordinals);
+    sort(purged_ordinals.begin(), purged_ordinals.end());
+    ASSERT_HINT(purged_ordinals == removed_ordinals, "Merge must report purged ordinals.");
+    size_t kept_count = 0;
+    for (const vector<int>& ordinals : term_ordinals) {
+        kept_count += count_if(ordinals.begin(), ordinals.end(), [&removed_ordinals](int ordinal) {
+            return !binary_search(removed_ordinals.begin(), removed_ordinals.end(), ordinal);
+        });
+    }
+    ASSERT_EQUAL_HINT(merged->GetPostingCount(), kept_count, "Merge must drop postings of removed ordinals.");
+
+    // A single posting with term count 1 packs into no data words at all
+    SearchServer single_server;
+    single_server.AddDocument(0, "cat"s, DocumentStatus::ACTUAL, {1});
+    single_server.CompactIndex();
+    single_server.CompactIndex();
+    ASSERT_EQUAL_HINT(single_server.FindTopDocuments("cat"s).size(), 1u, "Single posting must be found after compaction.");
+    ASSERT_EQUAL_HINT(get<0>(single_server.MatchDocument("cat"s, 0)).size(), 1u, "Single posting must match after compaction.");
+}
+
+void TestDynamicPruning() {
+    mt19937 generator(11);
+    vector<string> words = {"common"s, "frequent"s};
+    for (int i = 0; i < 40; ++i) {
+        words.push_back("word"s + to_string(i));
+    }
+    SearchServer search_server("and"s);
+    search_server.SetIndexBufferLimit(300);
+    for (int id = 0; id < 1500; ++id) {
+        string text = generator() % 10 < 9 ? "common"s : "and"s;
+        const int word_count = 1 + static_cast<int>(generator() % 12);
+        for (int i = 0; i < word_count; ++i) {
+            // Skewed towards the first words, so they repeat within documents
+            text += ' ' + words[min(generator() % words.size(), generator() % words.size())];
+        }
+        const DocumentStatus status = generator() % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        search_server.AddDocument(id, text, status, {static_cast<int>(generator() % 5)});
+    }
+    vector<int> removed_ids;
+    for (int id = 0; id < 1500; id += 7) {
+        removed_ids.push_back(id);
+    }
+    search_server.RemoveDocuments(execution::seq, removed_ids);
+    SearchServer exhaustive_server = search_server;
+    exhaustive_server.SetRetrievalMode(RetrievalMode::EXHAUSTIVE);
+    for (int round = 0; round < 300; ++round) {
+        string query = round % 2 == 0 ? "common"s : ""s;
+        const int word_count = 1 + static_cast<int>(generator() % 5);
+        for (int i = 0; i < word_count; ++i) {
+            query += (generator() % 8 == 0 ? " -"s : " "s) + words[generator() % words.size()];
+        }
+        const size_t max_result_count = 1 + generator() % 20;
+        const auto predicate = [](int document_id, DocumentStatus status, int rating) {
+            return status == DocumentStatus::ACTUAL && document_id % 3 != 0;
+        };
+        const auto expected = exhaustive_server.FindTopDocuments(execution::seq, query, predicate, max_result_count);
+        for (const auto& result : {search_server.FindTopDocuments(execution::seq, query, predicate, max_result_count),
+                                   search_server.FindTopDocuments(execution::par, query, predicate, max_result_count)}) {
+            ASSERT_EQUAL_HINT(result.size(), expected.size(), "Pruning changes the number of results.");
+            for (size_t i = 0; i < result.size(); ++i) {
+                ASSERT_EQUAL_HINT(result[i].id, expected[i].id, "Pruning changes search results.");
+                ASSERT_HINT(result[i].relevance == expected[i].relevance, "Pruning changes relevance.");
+            }
+        }
+    }
+}
+
+void TestStatusFiltering() {
+    mt19937 generator(19);
+    SearchServer search_server;
+    search_server.SetIndexBufferLimit(500);
+    // Statuses come in long runs of ids, so whole posting blocks hold one status
+    const DocumentStatus statuses[] = {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED, DocumentStatus::REMOVED};
+    for (int id = 0; id < 3000; ++id) {
+        string text = "common"s;
+        for (int i = 0; i < 5; ++i) {
+            text += " word"s + to_string(generator() % 30);
+        }
+        search_server.AddDocument(id, text, statuses[id / 400 % 4], {static_cast<int>(generator() % 10)});
+    }
+    search_server.RemoveDocuments(execution::seq, vector<int>{5, 6, 407, 2999});
+    const auto check_statuses = [](const SearchServer& server, const string& hint) {
+        for (const string& query : {"common"s, "word1 word2 -word3"s, "common word7"s}) {
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                const auto predicate = [status](int document_id, DocumentStatus document_status, int rating) {
+                    return document_status == status;
+                };
+                const auto expected = server.FindTopDocuments(execution::seq, query, predicate, 50);
+                for (const auto& result : {server.FindTopDocuments(query, status, 50), server.FindTopDocuments(execution::par, query, status, 50)}) {
+                    ASSERT_EQUAL_HINT(result.size(), expected.size(), hint);
+                    for (size_t i = 0; i < result.size(); ++i) {
+                        ASSERT_EQUAL_HINT(result[i].id, expected[i].id, hint);
+                    }
+                }
+            }
+        }
+    };
+    check_statuses(search_server, "Status filter differs from the generic predicate."s);
+    search_server.SetRetrievalMode(RetrievalMode::EXHAUSTIVE);
+    check_statuses(search_server, "Exhaustive status filter differs from the generic predicate."s);
+    search_server.SetRetrievalMode(RetrievalMode::PRUNED);
+
+    const auto generation = search_server.GetIndexGeneration();
+    for (int id = 0; id < 3000; id += 3) {
+        if (id != 6 && id != 2999) {
+            search_server.SetDocumentStatus(id, statuses[generator() % 4]);
+        }
+    }
+    ASSERT_HINT(search_server.GetIndexGeneration() != generation, "Status changes must change the index generation.");
+    check_statuses(search_server, "Status filter differs after status changes."s);
+    search_server.SetDocumentStatus(1, DocumentStatus::BANNED);
+    ASSERT_HINT(get<1>(search_server.MatchDocument("common"s, 1)) == DocumentStatus::BANNED, "Document must report its new status.");
+    const auto banned = search_server.FindTopDocuments("common"s, DocumentStatus::BANNED, 3000);
+    ASSERT_HINT(any_of(banned.begin(), banned.end(), [](const Document& document) { return document.id == 1; }),
+                "Document must be found by its new status.");
+    const auto actual = search_server.FindTopDocuments("common"s, DocumentStatus::ACTUAL, 3000);
+    ASSERT_HINT(none_of(actual.begin(), actual.end(), [](const Document& document) { return document.id == 1; }),
+                "Document must not be found by its old status.");
+    try {
+        search_server.SetDocumentStatus(5, DocumentStatus::ACTUAL);
+        ASSERT_HINT(false, "Status of a removed document must not be set.");
+    } catch (const invalid_argument&) {
+    }
+
+    const string path = MakeTemporaryPath();
+    search_server.SaveIndex(path);
+    const SearchServer loaded_server = SearchServer::LoadIndex(path);
+    check_statuses(loaded_server, "Loaded index filters statuses differently."s);
+    ASSERT_EQUAL_HINT(loaded_server.FindTopDocuments("common"s, DocumentStatus::BANNED, 3000).size(), banned.size(),
+                      "Loaded index has other documents of a status.");
+    remove(path.c_str());
+}
+
+void TestProcessQueries() {
+    WorkStealingPool pool(3);
+    vector<atomic_int> run_counts(1000);
+    pool.Run(run_counts.size(), [&run_counts](size_t i) {
+        ++run_counts[i];
+    });
+    ASSERT_HINT(all_of(run_counts.begin(), run_counts.end(), [](const atomic_int& count) { return count == 1; }),
+                "Every task must run once.");
+    try {
+        pool.Run(10, [](size_t i) {
+            if (i == 7) {
+                throw out_of_range("task"s);
+            }
+        });
+        ASSERT_HINT(false, "Exception of a task must reach the caller.");
+    } catch (const out_of_range&) {
+    }
+    // Tasks running batches of their own pool must not wait for the batch they are part of
+    vector<atomic_int> nested_run_counts(40);
+    pool.Run(4, [&pool, &nested_run_counts](size_t i) {
+        pool.Run(10, [&nested_run_counts, i](size_t j) {
+            ++nested_run_counts[i * 10 + j];
+        });
+    });
+    ASSERT_HINT(all_of(nested_run_counts.begin(), nested_run_counts.end(), [](const atomic_int& count) { return count == 1; }),
+                "Every nested task must run once.");
+
+    mt19937 generator(20);
+    SearchServer search_server("and"s);
+    for (int id = 0; id < 2000; ++id) {
+        string text = id % 2 == 0 ? "common"s : "and"s;
+        for (int i = 0; i < 4; ++i) {
+            text += " word"s + to_string(generator() % 50);
+        }
+        search_server.AddDocument(id, text, id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {static_cast<int>(id % 7)});
+    }
+    vector<string> queries;
+    for (int i = 0; i < 40; ++i) {
+        string query = i % 10 == 0 ? "common -word3"s : "missing"s;
+        for (int j = 0; j < i % 4; ++j) {
+            query += " word"s + to_string(generator() % 50);
+        }
+        queries.push_back(query);
+    }
+    // A small task cost makes the executor split the queries with the common word
+    for (const auto& [thread_count, min_task_cost] : {pair{size_t{1}, size_t{1} << 14}, pair{size_t{3}, size_t{200}}, pair{size_t{4}, size_t{1}}}) {
+        QueryExecutor executor(thread_count, min_task_cost);
+        const auto results = executor.Process(search_server, queries);
+        ASSERT_EQUAL_HINT(results.size(), queries.size(), "Every query must get its result.");
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const auto expected = search_server.FindTopDocuments(queries[i]);
+            ASSERT_EQUAL_HINT(results[i].size(), expected.size(), "Executor finds other documents.");
+            for (size_t j = 0; j < expected.size(); ++j) {
+                ASSERT_EQUAL_HINT(results[i][j].id, expected[j].id, "Executor finds other documents.");
+                ASSERT_HINT(results[i][j].relevance == expected[j].relevance, "Executor computes other relevance.");
+            }
+        }
+    }
+
+    const JoinedDocuments joined = ProcessQueriesJoined(search_server, queries);
+    vector<int> joined_ids;
+    for (const Document& document : joined) {
+        joined_ids.push_back(document.id);
+    }
+    vector<int> expected_ids;
+    for (const string& query : queries) {
+        for (const Document& document : search_server.FindTopDocuments(query)) {
+            expected_ids.push_back(document.id);
+        }
+    }
+    ASSERT_HINT(joined_ids == expected_ids, "Joined documents must follow the order of queries.");
+    ASSERT_EQUAL_HINT(joined.size(), expected_ids.size(), "Joined size must count documents of all queries.");
+    try {
+        ProcessQueries(search_server, {"cat"s, "--cat"s});
+        ASSERT_HINT(false, "Invalid query must throw.");
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestAsyncRequestQueue() {
+    using Clock = chrono::steady_clock;
+    LatencyHistogram histogram(chrono::seconds(60), 6);
+    const Clock::time_point start = Clock::now();
+    for (int i = 1; i <= 1000; ++i) {
+        histogram.Record(chrono::microseconds(i), start);
+    }
+    const auto median = histogram.GetPercentile(0.5, start);
+    ASSERT_HINT(median >= chrono::microseconds(500) && median <= chrono::microseconds(500) * 17 / 16, "Median is off by more than a bucket.");
+    ASSERT_HINT(histogram.GetPercentile(0.999, start) >= chrono::microseconds(999), "p999 is too low.");
+    ASSERT_EQUAL_HINT(histogram.GetCount(start + chrono::seconds(30)), 1000u, "Latencies within the window must count.");
+    ASSERT_EQUAL_HINT(histogram.GetCount(start + chrono::seconds(61)), 0u, "Latencies must leave the window.");
+
+    mt19937 generator(21);
+    SearchServer search_server("and"s);
+    for (int id = 0; id < 3000; ++id) {
+        string text = "common"s;
+        for (int i = 0; i < 4; ++i) {
+            text += " word"s + to_string(generator() % 40);
+        }
+        search_server.AddDocument(id, text, id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {static_cast<int>(id % 9)});
+    }
+    auto expired_query = search_server.CompileQuery("common word1"s);
+    expired_query.deadline = Clock::now();
+    for (const RetrievalMode mode : {RetrievalMode::EXHAUSTIVE, RetrievalMode::PRUNED}) {
+        search_server.SetRetrievalMode(mode);
+        try {
+            search_server.FindTopDocuments(execution::par, expired_query, DocumentStatus::ACTUAL);
+            ASSERT_HINT(false, "Query past its deadline must throw.");
+        } catch (const DeadlineExceededError&) {
+        }
+    }
+
+    vector<string> queries;
+    for (int i = 0; i < 100; ++i) {
+        queries.push_back("word"s + to_string(generator() % 40) + " word"s + to_string(generator() % 40) + (i % 5 == 0 ? " missing"s : ""s));
+    }
+    queries.push_back("missing"s);
+    AsyncRequestQueue request_queue(search_server, 3, 8);
+    vector<future<vector<Document>>> results(queries.size());
+    // Two producers compete for the queue
+    thread producer([&] {
+        for (size_t i = 0; i < queries.size(); i += 2) {
+            results[i] = request_queue.Submit(queries[i], i % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL);
+        }
+    });
+    for (size_t i = 1; i < queries.size(); i += 2) {
+        results[i] = request_queue.Submit(queries[i]);
+    }
+    producer.join();
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto documents = results[i].get();
+        const auto expected = search_server.FindTopDocuments(queries[i], i % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL);
+        ASSERT_EQUAL_HINT(documents.size(), expected.size(), "Async request finds other documents.");
+        for (size_t j = 0; j < expected.size(); ++j) {
+            ASSERT_EQUAL_HINT(documents[j].id, expected[j].id, "Async request finds other documents.");
+        }
+    }
+    ASSERT_EQUAL_HINT(request_queue.GetNoResultRequests(), 1, "Empty results must be counted.");
+    ASSERT_HINT(request_queue.GetLatencyPercentile(0.5) > chrono::nanoseconds(0), "Latencies must be recorded.");
+    ASSERT_HINT(request_queue.GetLatencyPercentile(0.5) <= request_queue.GetLatencyPercentile(0.99)
+                && request_queue.GetLatencyPercentile(0.99) <= request_queue.GetLatencyPercentile(0.999), "Percentiles must be ordered.");
+
+    auto expired = request_queue.Submit("common"s, DocumentStatus::ACTUAL, Clock::now());
+    try {
+        expired.get();
+        ASSERT_HINT(false, "Request past its deadline must fail.");
+    } catch (const DeadlineExceededError&) {
+    }
+    ASSERT_EQUAL_HINT(request_queue.GetExpiredCount(), 1u, "Expired requests must be counted.");
+    auto invalid = request_queue.Submit("--common"s);
+    try {
+        invalid.get();
+        ASSERT_HINT(false, "Invalid request must fail.");
+    } catch (const invalid_argument&) {
+    }
+
+    size_t accepted_count = 0;
+    vector<future<vector<Document>>> accepted;
+    for (int i = 0; i < 200; ++i) {
+        if (auto result = request_queue.TrySubmit("common word"s + to_string(i % 40))) {
+            accepted.push_back(move(*result));
+            ++accepted_count;
+        }
+    }
+    for (auto& result : accepted) {
+        result.get();
+    }
+    ASSERT_EQUAL_HINT(accepted_count + request_queue.GetRejectedCount(), 200u, "Every request must be either accepted or rejected.");
+}
+
+void TestInstrumentation() {
+    const Probe probe("TestInstrumentation.values");
+    const Probe same_probe("TestInstrumentation.values");
+    // Recorded by a thread which exits before the stats are collected
+    thread recorder([&probe] {
+        for (uint64_t value = 1; value <= 1000; ++value) {
+            probe.Record(value);
+        }
+    });
+    recorder.join();
+    same_probe.Record(100000);
+    const Probe timer_probe("TestInstrumentation.timer");
+    {
+        const ProbeTimer timer(timer_probe);
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    const auto stats = CollectProbeStats();
+    const auto find_stats = [&stats](const string& name) {
+        return find_if(stats.begin(), stats.end(), [&name](const ProbeStats& probe_stats) {
+            return probe_stats.name == name;
+        });
+    };
+    const auto values = find_stats("TestInstrumentation.values"s);
+    ASSERT_HINT(values != stats.end(), "Probe must be collected.");
+    ASSERT_EQUAL_HINT(values->count, 1001u, "Probes of one name must share their stats, also of exited threads.");
+    ASSERT_EQUAL_HINT(values->total, 500500u + 100000u, "Total is wrong.");
+    ASSERT_EQUAL_HINT(values->max, 100000u, "Maximum is wrong.");
+    ASSERT_HINT(values->p50 >= 500 && values->p50 <= 500 * 5 / 4, "Median is off by more than a bucket.");
+    ASSERT_HINT(values->p50 <= values->p99 && values->p99 <= values->max, "Percentiles must be ordered.");
+    const auto timer = find_stats("TestInstrumentation.timer"s);
+    ASSERT_HINT(timer != stats.end() && timer->count == 1, "Timer must record once.");
+    ASSERT_HINT(timer->total >= 1000000u, "Timer must record nanoseconds.");
+
+    ostringstream json;
+    DumpProbeStats(json, ProbeFormat::JSON);
+    ASSERT_HINT(json.str().find("{\"name\":\"TestInstrumentation.values\",\"count\":1001,"s) != string::npos, "JSON dump misses the probe.");
+    ostringstream text;
+    DumpProbeStats(text);
+    ASSERT_HINT(text.str().find("TestInstrumentation.timer: 1 calls"s) != string::npos, "Text dump misses the probe.");
+}
+
+void TestMatchDocuments() {
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "white cat and fluffy tail"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "black dog and fluffy cat"s, DocumentStatus::BANNED, {2});
+    search_server.AddDocument(3, "catfish in the city"s, DocumentStatus::ACTUAL, {3});
+    search_server.SetIndexBufferLimit(4);
+    for (int id = 4; id < 40; ++id) {
+        search_server.AddDocument(id, "word"s + to_string(id) + " fluffy cat"s, DocumentStatus::ACTUAL, {id});
+    }
+
+    // The plus word is a prefix of a minus word, which must not confuse the match
+    const string raw_query = "-catfish tail cat fluffy tail"s;
+    const auto [words, status] = search_server.MatchDocument(raw_query, 1);
+    ASSERT_EQUAL_HINT(words.size(), 3u, "Every distinct plus word must be matched once.");
+    ASSERT_HINT(words[0] == "cat"sv && words[1] == "fluffy"sv && words[2] == "tail"sv, "Matched words must be sorted.");
+    const auto word_freqs = search_server.GetWordFrequencies(1);
+    for (const string_view word : words) {
+        ASSERT_HINT(word.data() < raw_query.data() || word.data() >= raw_query.data() + raw_query.size(),
+                    "Matched words must not point into the query.");
+        ASSERT_HINT(word_freqs.find(word)->first.data() == word.data(), "Matched words must point into the term storage.");
+    }
+    ASSERT_HINT(get<0>(search_server.MatchDocument(raw_query, 3)).empty(), "Document with a minus word must match nothing.");
+    ASSERT_HINT(get<0>(search_server.MatchDocument("missing"s, 1)).empty(), "Unknown words must not match.");
+
+    vector<int> document_ids;
+    for (int id = 39; id > 0; id -= 2) {
+        document_ids.push_back(id);
+    }
+    document_ids.push_back(2);
+    const string batch_query = "fluffy cat -word7 word9 white"s;
+    const auto matches = search_server.MatchDocuments(batch_query, document_ids);
+    const auto parallel_matches = search_server.MatchDocuments(execution::par, batch_query, document_ids);
+    ASSERT_EQUAL_HINT(matches.size(), document_ids.size(), "Every document must be matched.");
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        const auto expected = search_server.MatchDocument(batch_query, document_ids[i]);
+        ASSERT_HINT(matches[i] == expected, "Batch match differs from a single one.");
+        ASSERT_HINT(parallel_matches[i] == expected, "Parallel batch match differs from a single one.");
+        ASSERT_HINT(search_server.MatchDocument(execution::par, batch_query, document_ids[i]) == expected,
+                    "Parallel match differs from a sequential one.");
+    }
+    ASSERT_HINT(get<0>(matches.front()).size() == 2 && get<0>(matches.front())[0] == "cat"sv, "Matched words are wrong.");
+    ASSERT_HINT(get<0>(matches[16]).empty(), "Document with a minus word must match nothing.");
+    ASSERT_HINT(get<1>(matches.back()) == DocumentStatus::BANNED, "Status of the document must be returned.");
+    try {
+        search_server.MatchDocuments(batch_query, {1, 100});
+        ASSERT_HINT(false, "Unknown document must throw.");
+    } catch (const out_of_range&) {
+    }
+}
+
+void TestSmallVector() {
+    SmallVector<int, 4> values = {3, 1, 2};
+    ASSERT_EQUAL_HINT(values.capacity(), 4u, "Few values must stay inline.");
+    for (int i = 4; i <= 20; ++i) {
+        values.push_back(i);
+    }
+    ASSERT_EQUAL_HINT(values.size(), 20u, "Values past the inline capacity are lost.");
+    ASSERT_HINT(values[0] == 3 && values[1] == 1 && values.back() == 20, "Values must keep their order when moved to the heap.");
+    const size_t capacity = values.capacity();
+    values.clear();
+    ASSERT_HINT(values.empty() && values.capacity() == capacity, "clear must keep the buffer.");
+
+    SmallVector<int, 4> inline_values = {5, 4, 4};
+    SmallVector<int, 4> heap_values;
+    heap_values.resize(10);
+    ASSERT_HINT(all_of(heap_values.begin(), heap_values.end(), [](int value) {
+                    return value == 0;
+                }), "resize must value-initialize.");
+    heap_values[9] = 7;
+    const SmallVector<int, 4> inline_copy = inline_values;
+    SmallVector<int, 4> heap_copy = heap_values;
+    ASSERT_HINT(inline_copy == inline_values && heap_copy == heap_values, "Copies must be equal.");
+    heap_copy[0] = 1;
+    ASSERT_EQUAL_HINT(heap_values[0], 0, "Copies must not share values.");
+    SmallVector<int, 4> moved_inline = move(inline_values);
+    SmallVector<int, 4> moved_heap = move(heap_values);
+    ASSERT_HINT(moved_inline == inline_copy && inline_values.empty(), "Inline values are moved wrong.");
+    ASSERT_HINT(moved_heap.size() == 10 && moved_heap[9] == 7 && heap_values.empty(), "Heap values are moved wrong.");
+    moved_heap = moved_inline;
+    ASSERT_HINT(moved_heap == inline_copy, "Assignment over a heap buffer is wrong.");
+    sort(moved_heap.begin(), moved_heap.end());
+    moved_heap.resize(unique(moved_heap.begin(), moved_heap.end()) - moved_heap.begin());
+    const SmallVector<int, 4> unique_values = {4, 5};
+    ASSERT_HINT(moved_heap == unique_values, "Algorithms must work on the pointers.");
+    // Values of the vector itself pushed when it is full, inline and on the heap
+    SmallVector<int, 4> aliased_values = {6, 7, 8, 9};
+    aliased_values.push_back(aliased_values[0]);
+    for (int i = 0; i < 3; ++i) {
+        aliased_values.push_back(i);
+    }
+    aliased_values.push_back(aliased_values[1]);
+    const SmallVector<int, 4> expected_aliased_values = {6, 7, 8, 9, 6, 0, 1, 2, 7};
+    ASSERT_HINT(aliased_values == expected_aliased_values, "Pushing a value of the full vector itself must copy it first.");
+
+    // Queries with more words than fit inline
+    SearchServer search_server("and"s);
+    string text;
+    string raw_query = "-missing"s;
+    for (int i = 0; i < 40; ++i) {
+        text += " word"s + to_string(i);
+        raw_query += " word"s + to_string(39 - i) + " word"s + to_string(i % 5) + " -absent"s + to_string(i);
+    }
+    search_server.AddDocument(1, text, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "word1 other"s, DocumentStatus::ACTUAL, {1});
+    const auto query = search_server.CompileQuery(raw_query);
+    ASSERT_EQUAL_HINT(query.plus_term_ids.size(), 40u, "Long query must keep every distinct indexed word.");
+    ASSERT_HINT(query.minus_term_ids.empty(), "Words which are not indexed must be dropped.");
+    const auto [words, status] = search_server.MatchDocument(raw_query, 1);
+    ASSERT_EQUAL_HINT(words.size(), 40u, "Long query must match every distinct word.");
+    ASSERT_HINT(is_sorted(words.begin(), words.end()), "Matched words must be sorted.");
+    ASSERT_EQUAL_HINT(search_server.FindTopDocuments(raw_query + " -other"s).size(), 1u, "Minus word past the inline capacity is lost.");
+}
+
+void TestThrowingPredicate() {
+    SearchServer search_server;
+    for (int id = 1; id <= 3; ++id) {
+        search_server.AddDocument(id, "cat"s, DocumentStatus::ACTUAL, {id});
+    }
+    // One predicate type for the failed and the next queries, so they share the per-thread buffers
+    bool is_failing = false;
+    const auto predicate = [&is_failing](int document_id, DocumentStatus, int) {
+        if (is_failing && document_id == 3) {
+            throw runtime_error("Predicate failed");
+        }
+        return !is_failing;
+    };
+    const auto query = search_server.CompileQuery("cat"s);
+    for (const RetrievalMode mode : {RetrievalMode::EXHAUSTIVE, RetrievalMode::PRUNED}) {
+        search_server.SetRetrievalMode(mode);
+        for (const size_t part_count : {1u, 2u}) {
+            is_failing = true;
+            for (size_t part = 0; part < part_count; ++part) {
+                try {
+                    search_server.FindTopDocumentsPart(query, predicate, part, part_count);
+                } catch (const runtime_error&) {
+                }
+            }
+            is_failing = false;
+            ASSERT_EQUAL_HINT(search_server.FindTopDocuments("cat"s, predicate).size(), 3u, "Failed query leaks into the next one.");
+            size_t found_count = 0;
+            for (size_t part = 0; part < 3; ++part) {
+                found_count += search_server.FindTopDocumentsPart(query, predicate, part, 3).size();
+            }
+            ASSERT_EQUAL_HINT(found_count, 3u, "Failed query leaks into the next one.");
+        }
+    }
+}
+
+void TestParallelShards() {
+    mt19937 generator(4);
+    SearchServer search_server("and"s);
+    search_server.SetIndexBufferLimit(2000);
+    for (int id = 0; id < 3000; ++id) {
+        string text;
+        for (int i = 0; i < 6; ++i) {
+            text += " word"s + to_string(generator() % 60);
+        }
+        const DocumentStatus status = id % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        search_server.AddDocument(id, text, status, {static_cast<int>(generator() % 10)});
+    }
+    search_server.RemoveDocument(5);
+    const auto same_documents = [](const vector<Document>& lhs, const vector<Document>& rhs) {
+        return equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Document& l, const Document& r) {
+            return l.id == r.id && l.rating == r.rating && abs(l.relevance - r.relevance) < 1e-9;
+        });
+    };
+    const auto predicate = [](int document_id, DocumentStatus, int rating) {
+        return document_id % 3 != 0 && rating > 2;
+    };
+    for (const size_t shard_count : {3u, 4u, 5u}) {
+        search_server.SetParallelShardCount(shard_count);
+        for (const RetrievalMode mode : {RetrievalMode::EXHAUSTIVE, RetrievalMode::PRUNED}) {
+            search_server.SetRetrievalMode(mode);
+            for (int i = 0; i < 20; ++i) {
+                const string query = "word"s + to_string(generator() % 60) + " word"s + to_string(generator() % 60) + " word"s
+                                     + to_string(generator() % 60) + (i % 3 == 0 ? " -word"s + to_string(generator() % 60) : ""s);
+                const size_t max_result_count = 1 + i % 8;
+                ASSERT_HINT(same_documents(search_server.FindTopDocuments(execution::par, query, predicate),
+                                           search_server.FindTopDocuments(execution::seq, query, predicate)),
+                            "Sharded predicate query differs from a sequential one.");
+                ASSERT_HINT(same_documents(search_server.FindTopDocuments(execution::par, query, DocumentStatus::BANNED),
+                                           search_server.FindTopDocuments(execution::seq, query, DocumentStatus::BANNED)),
+                            "Sharded status query differs from a sequential one.");
+                const auto limited = search_server.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, max_result_count);
+                ASSERT_HINT(limited.size() <= max_result_count, "Sharded query returns too many documents.");
+                ASSERT_HINT(same_documents(limited, search_server.FindTopDocuments(execution::seq, query, DocumentStatus::ACTUAL, max_result_count)),
+                            "Sharded limited query differs from a sequential one.");
+            }
+        }
+    }
+}
+
 // Функция TestSearchServer является точкой входа для запуска тестов
 void TestSearchServer() {
     TestFindQueryWords();
@@ -143,4 +1164,26 @@ void TestSearchServer() {
     TestFindStatus();
     TestRelevanceCalc();
     TestRelevanceSort();
+    TestResultCount();
+    TestRemoveDocument();
+    TestRemoveDocuments();
+    TestRemoveDuplicates();
+    TestQueryCache();
+    TestConcurrentSearchServer();
+    TestCompactIndex();
+    TestAddDocuments();
+    TestIndexSnapshot();
+    TestIngestDocuments();
+    TestIndexSegments();
+    TestOrdinalSetOps();
+    TestCompressedPostings();
+    TestDynamicPruning();
+    TestStatusFiltering();
+    TestProcessQueries();
+    TestAsyncRequestQueue();
+    TestInstrumentation();
+    TestMatchDocuments();
+    TestSmallVector();
+    TestThrowingPredicate();
+    TestParallelShards();
 }
@@ -56,6 +56,50 @@ void TestRelevanceCalc() ;
 
 void TestRelevanceSort() ;
 
+void TestResultCount() ;
+
+void TestRemoveDocument() ;
+
+void TestRemoveDocuments() ;
+
+void TestRemoveDuplicates() ;
+
+void TestQueryCache() ;
+
+void TestConcurrentSearchServer() ;
+
+void TestCompactIndex() ;
+
+void TestAddDocuments() ;
+
+void TestIndexSnapshot() ;
+
+void TestIngestDocuments() ;
+
+void TestIndexSegments() ;
+
+void TestOrdinalSetOps() ;
+
+void TestCompressedPostings() ;
+
+void TestDynamicPruning() ;
+
+void TestStatusFiltering() ;
+
+void TestProcessQueries() ;
+
+void TestAsyncRequestQueue() ;
+
+void TestInstrumentation() ;
+
+void TestMatchDocuments() ;
+
+void TestSmallVector() ;
+
+void TestThrowingPredicate() ;
+
+void TestParallelShards() ;
+
 // Функция TestSearchServer является точкой входа для запуска тестов
 void TestSearchServer() ;
 
@@ -0,0 +1,10 @@
+#include "test_example_functions.h"
+
+#include <iostream>
+
+using namespace std;
+
+int main() {
+    TestSearchServer();
+    cout << "Search server testing finished"s << endl;
+}
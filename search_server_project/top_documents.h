@@ -0,0 +1,36 @@
+#pragma once
+
+#include "document.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+const double RELEVANCE_EPSILON = 1e-6;
+
+// Relevances closer than RELEVANCE_EPSILON are treated as equal and ordered by rating;
+// the document id only settles the order of otherwise identical results.
+inline bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < RELEVANCE_EPSILON) {
+        if (lhs.rating != rhs.rating) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+// Keeps only the count most relevant documents in no particular order
+inline void TrimTopDocuments(std::vector<Document>& documents, size_t count) {
+    if (documents.size() > count) {
+        std::nth_element(documents.begin(), documents.begin() + count, documents.end(), IsMoreRelevant);
+        documents.resize(count);
+    }
+}
+
+// Keeps only the count most relevant documents, sorted by IsMoreRelevant.
+// Costs O(n + count log count) instead of sorting all n documents.
+inline void SelectTopDocuments(std::vector<Document>& documents, size_t count) {
+    TrimTopDocuments(documents, count);
+    std::sort(documents.begin(), documents.end(), IsMoreRelevant);
+}
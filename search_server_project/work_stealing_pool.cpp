@@ -0,0 +1,165 @@
+#include "work_stealing_pool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+// Pools whose tasks the thread is running, innermost first
+struct RunningPool {
+    const WorkStealingPool* pool;
+    const RunningPool* outer;
+};
+
+thread_local const RunningPool* running_pools = nullptr;
+
+bool IsRunningTasksOf(const WorkStealingPool* pool) {
+    for (const RunningPool* running = running_pools; running != nullptr; running = running->outer) {
+        if (running->pool == pool) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RunInline(size_t task_count, const function<void(size_t)>& task) {
+    exception_ptr exception;
+    for (size_t i = 0; i < task_count; ++i) {
+        try {
+            task(i);
+        } catch (...) {
+            if (!exception) {
+                exception = current_exception();
+            }
+        }
+    }
+    if (exception) {
+        rethrow_exception(exception);
+    }
+}
+}
+
+WorkStealingPool::WorkStealingPool(size_t thread_count) {
+    thread_count = max<size_t>(1, thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.push_back(make_unique<Worker>());
+    }
+    for (size_t i = 1; i < thread_count; ++i) {
+        threads_.emplace_back(&WorkStealingPool::RunThread, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        lock_guard<mutex> guard(state_mutex_);
+        stopped_ = true;
+    }
+    batch_started_.notify_all();
+    for (thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::Run(size_t task_count, const function<void(size_t)>& task) {
+    // Locking run_mutex_ would wait for the batch the calling task belongs to
+    if (IsRunningTasksOf(this)) {
+        RunInline(task_count, task);
+        return;
+    }
+    lock_guard<mutex> run_guard(run_mutex_);
+    if (task_count == 0) {
+        return;
+    }
+    const size_t worker_count = workers_.size();
+    for (size_t i = 0; i < worker_count; ++i) {
+        lock_guard<mutex> guard(workers_[i]->mutex);
+        for (size_t j = task_count * i / worker_count; j < task_count * (i + 1) / worker_count; ++j) {
+            workers_[i]->tasks.push_back(j);
+        }
+    }
+    {
+        lock_guard<mutex> guard(state_mutex_);
+        task_ = &task;
+        ++batch_;
+        busy_thread_count_ = threads_.size();
+    }
+    batch_started_.notify_all();
+    Work(0);
+    exception_ptr exception;
+    {
+        unique_lock<mutex> lock(state_mutex_);
+        batch_finished_.wait(lock, [this] {
+            return busy_thread_count_ == 0;
+        });
+        task_ = nullptr;
+        swap(exception, exception_);
+    }
+    if (exception) {
+        rethrow_exception(exception);
+    }
+}
+
+size_t WorkStealingPool::GetThreadCount() const {
+    return workers_.size();
+}
+
+void WorkStealingPool::RunThread(size_t worker) {
+    uint64_t batch = 0;
+    while (true) {
+        {
+            unique_lock<mutex> lock(state_mutex_);
+            batch_started_.wait(lock, [this, batch] {
+                return stopped_ || batch_ != batch;
+            });
+            if (stopped_) {
+                return;
+            }
+            batch = batch_;
+        }
+        Work(worker);
+        lock_guard<mutex> guard(state_mutex_);
+        if (--busy_thread_count_ == 0) {
+            batch_finished_.notify_all();
+        }
+    }
+}
+
+void WorkStealingPool::Work(size_t worker) {
+    const RunningPool running{this, running_pools};
+    running_pools = &running;
+    size_t task;
+    while (TakeTask(worker, task)) {
+        try {
+            (*task_)(task);
+        } catch (...) {
+            lock_guard<mutex> guard(state_mutex_);
+            if (!exception_) {
+                exception_ = current_exception();
+            }
+        }
+    }
+    running_pools = running.outer;
+}
+
+bool WorkStealingPool::TakeTask(size_t worker, size_t& task) {
+    {
+        Worker& own = *workers_[worker];
+        lock_guard<mutex> guard(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+    // No task is added during a batch, so deques found empty stay empty
+    for (size_t i = 1; i < workers_.size(); ++i) {
+        Worker& victim = *workers_[(worker + i) % workers_.size()];
+        lock_guard<mutex> guard(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
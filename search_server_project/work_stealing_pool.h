@@ -0,0 +1,63 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads running batches of indexed tasks. A batch is dealt out to the workers
+// as contiguous ranges; a worker takes tasks from the front of its own deque and, once it is
+// empty, steals from the back of the others, so uneven tasks even out without a central queue.
+// The thread calling Run is one of the workers.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(size_t thread_count);
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    ~WorkStealingPool();
+
+    // Runs task(i) for every i in [0, task_count) and returns once all are done. Batches of
+    // concurrent callers run one after another. If tasks throw, the first exception is
+    // rethrown once the batch is over.
+    // A task may call Run of its own pool: the nested batch then runs on the task's thread, as
+    // the workers are busy with the outer one. A cycle through another pool's workers, which
+    // cannot be told apart from a concurrent caller, deadlocks.
+    void Run(size_t task_count, const std::function<void(size_t)>& task);
+
+    size_t GetThreadCount() const;
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::mutex run_mutex_;
+
+    std::mutex state_mutex_;
+    std::condition_variable batch_started_;
+    std::condition_variable batch_finished_;
+    const std::function<void(size_t)>* task_ = nullptr;
+    uint64_t batch_ = 0;
+    size_t busy_thread_count_ = 0;
+    bool stopped_ = false;
+    std::exception_ptr exception_;
+
+    void RunThread(size_t worker);
+
+    // Runs tasks of the current batch until no worker has any left
+    void Work(size_t worker);
+
+    bool TakeTask(size_t worker, size_t& task);
+};